@@ -31,6 +31,9 @@
 #ifdef _WIN32
 #include <windows.h>
 #include <wincon.h>
+#elif _POSIX_C_SOURCE >= 1 || _XOPEN_SOURCE || _POSIX_SOURCE || _POSIX_VERSION || _POSIX2_VERSION
+#include <sys/wait.h>
+#define SERVER_MODE
 #endif
 #include <locale.h>
 #include "wchar.h"
@@ -50,6 +53,7 @@
 #include "unicode.h"
 #include "listing.h"
 #include "optimizer.h"
+#include "profile.h"
 
 #include "listobj.h"
 #include "codeobj.h"
@@ -98,7 +102,7 @@ uint16_t reffile, curfile;
 uint32_t backr, forwr;
 struct avltree *star_tree = NULL;
 
-static const char* command[] = { /* must be sorted, first char is the ID */
+static const char* command[] = { /* first char is the ID */
     "\x08" "addr",
     "\x22" "al",
     "\x34" "align",
@@ -222,6 +226,9 @@ static void status(void) {
         printf("Passes:            %u\n",pass);
         if (!errors) sectionprint();
     }
+    profile_print(stdout);
+    trace_print(stdout);
+    memstats_print(stdout);
     tfree();
     free_macro();
     free(waitfors);
@@ -266,6 +273,7 @@ static void set_size(const Label *label, size_t size, struct memblocks_s *mem, s
     Code *code = (Code *)label->value;
     size &= all_mem2;
     if (code->size != size) {
+        if (code->pass != 0) trace_label_address(TRACE_SIZE, label, code->size, size);
         code->size = size;
         if (code->pass != 0) {
             if (fixeddig && pass > max_pass) err_msg_cant_calculate(&label->name, &label->epoint);
@@ -355,59 +363,202 @@ void pokeb(uint8_t byte)
     }
 }
 
+/*
+ * reserve a run of output bytes, as long as it can go without wrapping
+ */
+static uint8_t *pokerun(size_t *len) {
+    size_t n = *len;
+    uint8_t *d = NULL;
+    if (current_section->moved) {
+        if (current_section->address < current_section->start) err_msg(ERROR_OUTOF_SECTION,NULL);
+        if (current_section->wrapwarn) {err_msg_mem_wrap();current_section->wrapwarn = false;}
+        current_section->moved = false;
+    }
+    if (current_section->l_address.address > 0xffff) {
+        current_section->l_address.address = 0;
+        err_msg_pc_wrap();
+    }
+    if (n > 0x10000 - current_section->l_address.address) n = 0x10000 - current_section->l_address.address;
+    if ((current_section->address & ~all_mem2) != 0) n = 1;
+    else if (n - 1 > (address_t)(all_mem2 - current_section->address)) n = (size_t)(all_mem2 - current_section->address) + 1;
+    if (current_section->dooutput) d = alloc_mem(&current_section->mem, n);
+    current_section->address += n;current_section->l_address.address += n;
+    if ((current_section->address & ~all_mem2) != 0 || current_section->address == 0) {
+        current_section->wrapwarn = current_section->moved = true;
+        if (current_section->end <= all_mem2) current_section->end = all_mem2 + 1;
+        current_section->address = 0;
+        memjmp(&current_section->mem, current_section->address);
+    }
+    *len = n;
+    return d;
+}
+
+/*
+ * output a run of bytes, same as calling pokeb for each of them
+ */
+static void pokedata(const uint8_t *data, size_t len) {
+    while (len != 0) {
+        size_t i, n = len;
+        uint8_t *d = pokerun(&n);
+        if (d != NULL) {
+            if (outputeor == 0) memcpy(d, data, n);
+            else for (i = 0; i < n; i++) d[i] = data[i] ^ outputeor;
+        }
+        data += n;
+        len -= n;
+    }
+}
+
+/*
+ * output the same byte len times
+ */
+static void pokefill(uint8_t byte, size_t len) {
+    while (len != 0) {
+        size_t n = len;
+        uint8_t *d = pokerun(&n);
+        if (d != NULL) memset(d, byte ^ outputeor, n);
+        len -= n;
+    }
+}
+
+/*
+ * copy a just written fill pattern, with room to repeat short ones
+ */
+static uint8_t *fill_pattern(size_t memp, size_t membp, size_t len, address_t db) {
+    size_t i, len2 = (len < 256 && db > len) ? len + 256 : len;
+    uint8_t *d;
+    if (len2 < len) err_msg_out_of_memory(); /* overflow */
+    d = (uint8_t *)mallocx(len2);
+    for (i = 0; i < len; i++) {
+        int16_t ch = read_mem(&current_section->mem, memp, membp, i);
+        if (ch < 0) {
+            free(d);
+            return NULL;
+        }
+        d[i] = (uint8_t)ch;
+    }
+    return d;
+}
+
 /* --------------------------------------------------------------------------- */
-static int get_command(void) {
-    unsigned int no, also = 0, felso, elozo;
+/* Directives are found through a perfect hash of their case folded name. The
+   seed is searched for on first use so that every directive gets its own slot
+   and a lookup is a single probe. */
+static uint8_t command_hash[4096]; /* index + 1 into command[] */
+static uint32_t command_seed;
+
+static inline unsigned int command_slot(const uint8_t *s, size_t l, uint32_t seed) {
+    size_t i;
+    uint32_t h = seed;
+    for (i = 0; i < l; i++) h = (h ^ (uint8_t)(s[i] | 0x20)) * 16777619U;
+    return (h ^ (h >> 12) ^ (h >> 24)) & (lenof(command_hash) - 1);
+}
+
+static void command_hash_init(void) {
+    size_t i;
+    for (command_seed = 2166136261U;; command_seed++) {
+        memset(command_hash, 0, sizeof command_hash);
+        for (i = 0; i < lenof(command); i++) {
+            const uint8_t *s = (const uint8_t *)command[i] + 1;
+            unsigned int j = command_slot(s, strlen((const char *)s), command_seed);
+            if (command_hash[j] != 0) break;
+            command_hash[j] = (uint8_t)(i + 1);
+        }
+        if (i == lenof(command)) return;
+    }
+}
+
+static int lookup_command(void) {
     const uint8_t *label;
     size_t l;
-    int s4;
     lpoint.pos++;
     label = pline + lpoint.pos;
     l = get_label();
     if (l != 0 && l < 19) {
-        char cmd[20];
-        if (arguments.caseinsensitive != 0) {
-            size_t i;
-            for (i = 0; i < l; i++) cmd[i] = label[i] | 0x20;
-        } else memcpy(cmd, label, l);
-        cmd[l] = 0;
-        if (l != 0) {
-            felso = sizeof(command)/sizeof(command[0]);
-            no = felso/2;
-            for (;;) {  /* do binary search */
-                if ((s4=strcmp(cmd, command[no] + 1)) == 0) {
-                    return (uint8_t)command[no][0];
-                }
-
-                elozo = no;
-                no = ((s4 > 0) ? (felso + (also = no)) : (also + (felso = no)))/2;
-                if (elozo == no) break;
+        const char *cmd;
+        unsigned int no;
+        size_t i;
+        if (command_seed == 0) command_hash_init();
+        no = command_hash[command_slot(label, l, command_seed)];
+        if (no != 0) {
+            cmd = command[no - 1] + 1;
+            if (arguments.caseinsensitive != 0) {
+                for (i = 0; i < l; i++) if ((uint8_t)cmd[i] != (label[i] | 0x20)) break;
+            } else {
+                for (i = 0; i < l; i++) if ((uint8_t)cmd[i] != label[i]) break;
             }
+            if (i == l && cmd[l] == 0) return (uint8_t)command[no - 1][0];
         }
     }
     lpoint.pos -= l;
     return lenof(command);
 }
 
+static int get_command(struct file_s *cfile) {
+    struct lcache_s *lcache = get_lcache(cfile);
+    linecpos_t pos = lpoint.pos;
+    int prm;
+    if (lcache == NULL) return lookup_command();
+    if (lcache->cmd != 0 && lcache->cmdpos == pos) {
+        lpoint.pos = lcache->cmdend;
+        return lcache->cmd - 1;
+    }
+    prm = lookup_command();
+    lcache->cmdpos = pos;
+    lcache->cmdend = lpoint.pos;
+    lcache->cmd = (uint8_t)(prm + 1);
+    return prm;
+}
+
 /* ------------------------------------------------------------------------------ */
 
-static void set_cpumode(const struct cpu_s *cpumode) {
+/* Returns true if register names were created for this cpu */
+static bool set_cpumode(const struct cpu_s *cpumode) {
     all_mem = cpumode->max_address;
     select_opcodes(cpumode);
     listing_set_cpumode(cpumode);
     cpu_opt_set_cpumode(cpumode);
-    if (registerobj_createnames(cpumode->registers)) constcreated = true;
+    return registerobj_createnames(cpumode->registers);
+}
+
+/* Label created after a lookup of its name failed in this pass */
+static void label_created(const Label *label, linepos_t epoint) {
+    if (pass > max_pass) err_msg_cant_calculate(&label->name, epoint);
+    trace_change(TRACE_NEW, &label->name, epoint, NULL, NULL);
+    constcreated = true;
 }
 
 void var_assign(Label *label, Obj *val, bool fix) {
+    if (label->defpass != pass) label_generation++;
     label->defpass = pass;
     if (val->obj->same(val, label->value)) return;
+    if (!fix && label->usepass >= pass) trace_label(TRACE_VALUE, label, label->value, val);
     val_replace(&label->value, val);
     if (label->usepass < pass) return;
     if (fixeddig && !fix && pass > max_pass) err_msg_cant_calculate(&label->name, &label->epoint);
     fixeddig = fix;
 }
 
+/*
+ * output plain text bytes, same as when they are iterated one by one
+ */
+static void textbytes(const uint8_t *data, size_t len, int *ch2, size_t *uninit, size_t *sum, size_t max) {
+    size_t n;
+    if (*ch2 >= 0) {
+        if (*uninit != 0) { memskip(*uninit); (*sum) += *uninit; *uninit = 0; }
+        pokeb(*ch2); (*sum)++;
+    }
+    *ch2 = data[0];
+    if (len < 2 || *sum >= max) return;
+    if (*uninit != 0) { memskip(*uninit); (*sum) += *uninit; *uninit = 0; }
+    n = len - 1;
+    if (*sum >= max) n = 1;
+    else if (n > max - *sum) n = max - *sum;
+    pokedata(data, n);
+    (*sum) += n;
+    *ch2 = data[n];
+}
+
 static bool textrecursion(Obj *val, int prm, int *ch2, size_t *uninit, size_t *sum, size_t max, linepos_t epoint2) {
     Iter *iter;
     Obj *val2 = NULL;
@@ -427,6 +578,11 @@ static bool textrecursion(Obj *val, int prm, int *ch2, size_t *uninit, size_t *s
             default: m = BYTES_MODE_TEXT; break;
             }
             tmp = bytes_from_str((Str *)val, epoint2, m);
+            if (m == BYTES_MODE_TEXT && tmp->obj == BYTES_OBJ && ((Bytes *)tmp)->len > 0) {
+                textbytes(((Bytes *)tmp)->data, ((Bytes *)tmp)->len, ch2, uninit, sum, max);
+                val_destroy(tmp);
+                return false;
+            }
             iter = tmp->obj->getiter(tmp);
             val_destroy(tmp);
             break;
@@ -468,6 +624,10 @@ static bool textrecursion(Obj *val, int prm, int *ch2, size_t *uninit, size_t *s
                 val2 = val;
                 goto doit;
             }
+            if (((Bytes *)val)->len > 0 && prm != CMD_SHIFT && prm != CMD_SHIFTL && prm != CMD_NULL) {
+                textbytes(((Bytes *)val)->data, len, ch2, uninit, sum, max);
+                return false;
+            }
         }
         /* fall through */
     default:
@@ -609,10 +769,15 @@ static bool byterecursion(Obj *val, int prm, size_t *uninit, int bits, linepos_t
             ch2 = 0;
         }
         if (*uninit != 0) {memskip(*uninit);*uninit = 0;}
-        pokeb((uint8_t)ch2);
-        if (prm>=CMD_RTA) pokeb((uint8_t)(ch2>>8));
-        if (prm>=CMD_LINT) pokeb((uint8_t)(ch2>>16));
-        if (prm>=CMD_DINT) pokeb((uint8_t)(ch2>>24));
+        if (prm>=CMD_RTA) {
+            uint8_t d[4];
+            size_t n = 2;
+            d[0] = (uint8_t)ch2;
+            d[1] = (uint8_t)(ch2>>8);
+            if (prm>=CMD_LINT) d[n++] = (uint8_t)(ch2>>16);
+            if (prm>=CMD_DINT) d[n++] = (uint8_t)(ch2>>24);
+            pokedata(d, n);
+        } else pokeb((uint8_t)ch2);
         if (iter == NULL) return warn;
         val_destroy(val2);
     }
@@ -731,6 +896,8 @@ Obj *compile(struct file_list_s *cflist)
 
     while (nobreak) {
         if (mtranslate(cfile)) break; /* expand macro parameters, if any */
+        profile_lines++;
+        if (arguments.profile != NULL || arguments.profilestacks != NULL) profile_line(cflist, lpoint.line);
         newlabel = NULL;
         labelname.len = 0;ignore();epoint = lpoint; mycontext = current_context;
         if (current_section->unionmode) {
@@ -975,10 +1142,7 @@ Obj *compile(struct file_list_s *cflist)
                     if (labelexists) {
                         if (label->defpass == pass) err_msg_double_defined(label, &labelname, &epoint);
                         else {
-                            if (!constcreated && temporary_label_branch == 0 && label->defpass != pass - 1) {
-                                if (pass > max_pass) err_msg_cant_calculate(&label->name, &epoint);
-                                constcreated = true;
-                            }
+                            if (!constcreated && temporary_label_branch == 0 && label->defpass != pass - 1 && label_missed(&labelname)) label_created(label, &epoint);
                             label->constant = true;
                             label->owner = false;
                             label->file_list = cflist;
@@ -987,10 +1151,7 @@ Obj *compile(struct file_list_s *cflist)
                         }
                         val_destroy(val);
                     } else {
-                        if (!constcreated && temporary_label_branch == 0) {
-                            if (pass > max_pass) err_msg_cant_calculate(&label->name, &epoint);
-                            constcreated = true;
-                        }
+                        if (!constcreated && temporary_label_branch == 0 && label_missed(&labelname)) label_created(label, &epoint);
                         label->constant = true;
                         label->owner = false;
                         label->value = val;
@@ -1004,7 +1165,7 @@ Obj *compile(struct file_list_s *cflist)
                     goto shifting;
                 }
                 cmdpoint = lpoint;
-                prm = get_command();
+                prm = get_command(cfile);
                 ignore();
                 if (labelname.data[0] == '*') {
                     err_msg2(ERROR______EXPECTED, "=", &epoint);
@@ -1065,10 +1226,7 @@ Obj *compile(struct file_list_s *cflist)
                         if (labelexists) {
                             if (label->defpass == pass) err_msg_double_defined(label, &labelname, &epoint);
                             else {
-                                if (!constcreated && temporary_label_branch == 0 && label->defpass != pass - 1) {
-                                    if (pass > max_pass) err_msg_cant_calculate(&label->name, &epoint);
-                                    constcreated = true;
-                                }
+                                if (!constcreated && temporary_label_branch == 0 && label->defpass != pass - 1 && label_missed(&labelname)) label_created(label, &epoint);
                                 label->constant = true;
                                 label->owner = true;
                                 label->file_list = cflist;
@@ -1077,10 +1235,7 @@ Obj *compile(struct file_list_s *cflist)
                             }
                             val_destroy(&lbl->v);
                         } else {
-                            if (!constcreated && temporary_label_branch == 0) {
-                                if (pass > max_pass) err_msg_cant_calculate(&label->name, &epoint);
-                                constcreated = true;
-                            }
+                            if (!constcreated && temporary_label_branch == 0 && label_missed(&labelname)) label_created(label, &epoint);
                             label->constant = true;
                             label->owner = true;
                             label->value = &lbl->v;
@@ -1111,10 +1266,7 @@ Obj *compile(struct file_list_s *cflist)
                                 err_msg_double_defined(label, &labelname, &epoint);
                                 waitfor->val = &macro->v;
                             } else {
-                                if (!constcreated && temporary_label_branch == 0 && label->defpass != pass - 1) {
-                                    if (pass > max_pass) err_msg_cant_calculate(&label->name, &epoint);
-                                    constcreated = true;
-                                }
+                                if (!constcreated && temporary_label_branch == 0 && label->defpass != pass - 1 && label_missed(&labelname)) label_created(label, &epoint);
                                 label->constant = true;
                                 label->owner = true;
                                 label->file_list = cflist;
@@ -1125,10 +1277,7 @@ Obj *compile(struct file_list_s *cflist)
                             }
                         } else {
                             macro->retval = false;
-                            if (!constcreated && temporary_label_branch == 0) {
-                                if (pass > max_pass) err_msg_cant_calculate(&label->name, &epoint);
-                                constcreated = true;
-                            }
+                            if (!constcreated && temporary_label_branch == 0 && label_missed(&labelname)) label_created(label, &epoint);
                             label->constant = true;
                             label->owner = true;
                             label->value = &macro->v;
@@ -1158,10 +1307,7 @@ Obj *compile(struct file_list_s *cflist)
                         if (labelexists) {
                             if (label->defpass == pass) err_msg_double_defined(label, &labelname, &epoint);
                             else {
-                                if (!constcreated && temporary_label_branch == 0 && label->defpass != pass - 1) {
-                                    if (pass > max_pass) err_msg_cant_calculate(&label->name, &epoint);
-                                    constcreated = true;
-                                }
+                                if (!constcreated && temporary_label_branch == 0 && label->defpass != pass - 1 && label_missed(&labelname)) label_created(label, &epoint);
                                 label->constant = true;
                                 label->owner = true;
                                 label->file_list = cflist;
@@ -1172,10 +1318,7 @@ Obj *compile(struct file_list_s *cflist)
                             }
                             val_destroy(&mfunc->v);
                         } else {
-                            if (!constcreated && temporary_label_branch == 0) {
-                                if (pass > max_pass) err_msg_cant_calculate(&label->name, &epoint);
-                                constcreated = true;
-                            }
+                            if (!constcreated && temporary_label_branch == 0 && label_missed(&labelname)) label_created(label, &epoint);
                             label->constant = true;
                             label->owner = true;
                             label->value = &mfunc->v;
@@ -1218,10 +1361,7 @@ Obj *compile(struct file_list_s *cflist)
                                 structure->names = new_namespace(cflist, &epoint);
                                 err_msg_double_defined(label, &labelname, &epoint);
                             } else {
-                                if (!constcreated && temporary_label_branch == 0 && label->defpass != pass - 1) {
-                                    if (pass > max_pass) err_msg_cant_calculate(&label->name, &epoint);
-                                    constcreated = true;
-                                }
+                                if (!constcreated && temporary_label_branch == 0 && label->defpass != pass - 1 && label_missed(&labelname)) label_created(label, &epoint);
                                 label->constant = true;
                                 label->owner = true;
                                 label->file_list = cflist;
@@ -1239,10 +1379,7 @@ Obj *compile(struct file_list_s *cflist)
                                 structure = (Struct *)label->value;
                             }
                         } else {
-                            if (!constcreated && temporary_label_branch == 0) {
-                                if (pass > max_pass) err_msg_cant_calculate(&label->name, &epoint);
-                                constcreated = true;
-                            }
+                            if (!constcreated && temporary_label_branch == 0 && label_missed(&labelname)) label_created(label, &epoint);
                             label->constant = true;
                             label->owner = true;
                             label->value = &structure->v;
@@ -1273,6 +1410,7 @@ Obj *compile(struct file_list_s *cflist)
 
                         if (doubledef) val_destroy(&structure->v);
                         else if (structure->size != (current_section->address & all_mem2)) {
+                            if (label->usepass >= pass) trace_label_address(TRACE_SIZE, label, structure->size, current_section->address & all_mem2);
                             structure->size = current_section->address & all_mem2;
                             if (label->usepass >= pass) {
                                 if (fixeddig && pass > max_pass) err_msg_cant_calculate(&label->name, &label->epoint);
@@ -1306,6 +1444,7 @@ Obj *compile(struct file_list_s *cflist)
                             tmp->end = tmp->start = tmp->restart = tmp->address = 0;
                             tmp->size = tmp->l_restart.address = tmp->l_restart.bank = tmp->l_address.address = tmp->l_address.bank = 0;
                             if (fixeddig && pass > max_pass) err_msg_cant_calculate(&sectionname, &opoint);
+                            trace_change(TRACE_SECTION, &sectionname, &opoint, NULL, NULL);
                             fixeddig = false;
                             tmp->defpass = pass - 1;
                             restart_memblocks(&tmp->mem, tmp->address);
@@ -1333,6 +1472,7 @@ Obj *compile(struct file_list_s *cflist)
             }
             {
                 bool labelexists = false;
+                bool missed;
                 Code *code;
                 if (labelname.data[0] == '*') {
                     err_msg2(ERROR______EXPECTED, "=", &epoint);
@@ -1340,6 +1480,7 @@ Obj *compile(struct file_list_s *cflist)
                     epoint = lpoint;
                     goto jn;
                 }
+                missed = label_missed(&labelname); /* before our own lookup */
                 if (!islabel) {
                     Namespace *parent;
                     bool down = (labelname.data[0] != '_');
@@ -1381,10 +1522,7 @@ Obj *compile(struct file_list_s *cflist)
                     }
                 }
                 if (labelexists) {
-                    if (!constcreated && temporary_label_branch == 0 && newlabel->defpass != pass - 1) {
-                        if (pass > max_pass) err_msg_cant_calculate(&newlabel->name, &epoint);
-                        constcreated = true;
-                    }
+                    if (!constcreated && temporary_label_branch == 0 && newlabel->defpass != pass - 1 && missed) label_created(newlabel, &epoint);
                     newlabel->constant = true;
                     newlabel->owner = true;
                     newlabel->file_list = cflist;
@@ -1395,6 +1533,7 @@ Obj *compile(struct file_list_s *cflist)
                         tmp = get_star_value(current_section->l_address_val);
                         code = (Code *)newlabel->value;
                         if (!tmp->obj->same(tmp, code->addr)) {
+                            if (newlabel->usepass >= pass) trace_label(TRACE_ADDRESS, newlabel, code->addr, tmp);
                             val_destroy(code->addr); code->addr = tmp;
                             if (newlabel->usepass >= pass) {
                                 if (fixeddig && pass > max_pass) err_msg_cant_calculate(&newlabel->name, &newlabel->epoint);
@@ -1406,6 +1545,7 @@ Obj *compile(struct file_list_s *cflist)
                             code->conflicts = current_section->conflicts;
                             if (newlabel->usepass >= pass) {
                                 if (fixeddig && pass > max_pass) err_msg_cant_calculate(&newlabel->name, &newlabel->epoint);
+                                trace_label(TRACE_REQUIRES, newlabel, NULL, NULL);
                                 fixeddig = false;
                             }
                         }
@@ -1417,10 +1557,7 @@ Obj *compile(struct file_list_s *cflist)
                 } else {
                     if (diagnostics.optimize) cpu_opt_invalidate();
                     code = new_code();
-                    if (!constcreated && temporary_label_branch == 0) {
-                        if (pass > max_pass) err_msg_cant_calculate(&newlabel->name, &epoint);
-                        constcreated = true;
-                    }
+                    if (!constcreated && temporary_label_branch == 0 && missed) label_created(newlabel, &epoint);
                     newlabel->constant = true;
                     newlabel->owner = true;
                     newlabel->value = (Obj *)code;
@@ -1446,6 +1583,10 @@ Obj *compile(struct file_list_s *cflist)
                     new_waitfor(W_PEND, &epoint);waitfor->label = newlabel;waitfor->addr = current_section->address;waitfor->memp = newmemp;waitfor->membp = newmembp;
                     if (!newlabel->ref && ((Code *)newlabel->value)->pass != 0) {waitfor->skip = 0; set_size(newlabel, 0, &current_section->mem, newmemp, newmembp);}
                     else {         /* TODO: first time it should not compile */
+                        if (((Code *)newlabel->value)->pass == 0 && !constcreated && temporary_label_branch == 0) { /* unused ones get dropped in the next pass */
+                            trace_label(TRACE_PROC, newlabel, NULL, NULL);
+                            constcreated = true;
+                        }
                         push_context(((Code *)newlabel->value)->names);
                         newlabel->ref = false;
                     }
@@ -1551,7 +1692,7 @@ Obj *compile(struct file_list_s *cflist)
             if ((waitfor->skip & 1) != 0) listing_line(epoint.pos);
             break;
         case '.':
-            prm = get_command();
+            prm = get_command(cfile);
             ignore();
         as_command:
             switch (prm) {
@@ -1996,10 +2137,9 @@ Obj *compile(struct file_list_s *cflist)
 
                         if (val2 != NULL) {
                             struct file_s *cfile2 = openfile(path, cfile->realname, 1, val2, &epoint);
-                            if (cfile2 != NULL) {
-                                for (; fsize != 0 && foffset < cfile2->len;fsize--) {
-                                    pokeb(cfile2->data[foffset]);foffset++;
-                                }
+                            if (cfile2 != NULL && foffset < cfile2->len) {
+                                if (fsize > cfile2->len - foffset) fsize = cfile2->len - foffset;
+                                pokedata(cfile2->data + foffset, fsize);
                             }
                         }
                         free(path);
@@ -2194,6 +2334,7 @@ Obj *compile(struct file_list_s *cflist)
                         else {
                             size_t uninit = 0, sum = 0;
                             size_t memp, membp;
+                            uint8_t *pattern;
                             int ch2=-1;
                             get_mem(&current_section->mem, &memp, &membp);
 
@@ -2206,10 +2347,19 @@ Obj *compile(struct file_list_s *cflist)
                             db -= sum;
                             if (db != 0) {
                                 if (sum == 1 && uninit == 0) {
-                                    while ((db--) != 0) pokeb(ch2); /* single byte shortcut */
+                                    pokefill(ch2, db); /* single byte shortcut */
                                 } else if (sum == uninit) {
                                     if (sum == 0) err_msg2(ERROR__BYTES_NEEDED, NULL, &vs->epoint);
                                     uninit += db; /* gap shortcut */
+                                } else if (uninit == 0 && (pattern = fill_pattern(memp, membp, sum, db)) != NULL) {
+                                    size_t len = sum;
+                                    for (; len < 256 && len < db; len += sum) memcpy(pattern + len, pattern, sum);
+                                    while (db != 0) { /* pattern repeat without gaps */
+                                        size_t n = (db < len) ? db : len;
+                                        pokedata(pattern, n);
+                                        db -= n;
+                                    }
+                                    free(pattern);
                                 } else {
                                     size_t offs = 0;
                                     while (db != 0) { /* pattern repeat */
@@ -2499,7 +2649,10 @@ Obj *compile(struct file_list_s *cflist)
                                     current_section->l_address.bank &= cpumode->max_address;
                                     err_msg2(ERROR_ADDRESS_LARGE, NULL, &epoint);
                                 }
-                                set_cpumode(cpumode);
+                                if (set_cpumode(cpumode)) {
+                                    trace_change(TRACE_REGISTERS, NULL, &epoint, NULL, NULL);
+                                    constcreated = true;
+                                }
                                 break;
                             }
                             cpui++;
@@ -2538,6 +2691,7 @@ Obj *compile(struct file_list_s *cflist)
 
                         if (labelexists && s->addr != star) {
                             if (fixeddig && pass > max_pass) err_msg_cant_calculate(NULL, &epoint);
+                            trace_address(TRACE_STAR, NULL, &epoint, s->addr, star);
                             fixeddig = false;
                         }
                         s->addr = star;
@@ -2620,6 +2774,7 @@ Obj *compile(struct file_list_s *cflist)
 
                         if (starexists && s->addr != star) {
                             if (fixeddig && pass > max_pass) err_msg_cant_calculate(NULL, &epoint);
+                            trace_address(TRACE_STAR, NULL, &epoint, s->addr, star);
                             fixeddig = false;
                         }
                         s->addr = star;
@@ -2661,9 +2816,15 @@ Obj *compile(struct file_list_s *cflist)
                                 }
                                 push_context((Namespace *)label->value);
                             }
+                            profile_enter(PROFILE_FILE, f, 0);
                             compile(cflist2);
+                            profile_exit();
                             pop_context();
-                        } else compile(cflist2);
+                        } else {
+                            profile_enter(PROFILE_FILE, f, 0);
+                            compile(cflist2);
+                            profile_exit();
+                        }
                         lpoint.line = lin; vline = vlin;
                         star_tree = stree_old;
                         backr = old_backr; forwr = old_forwr;
@@ -2681,6 +2842,7 @@ Obj *compile(struct file_list_s *cflist)
                     struct linepos_s apoint, bpoint = {0, 0};
                     int nopos = -1;
                     uint8_t *expr;
+                    const uint8_t *forline;
                     Label *label;
                     Obj *nf = NULL;
                     struct star_s *s;
@@ -2733,14 +2895,22 @@ Obj *compile(struct file_list_s *cflist)
                     if (starexists && s->addr != star) {
                         struct linepos_s nopoint = {0, 0};
                         if (fixeddig && pass > max_pass) err_msg_cant_calculate(NULL, &nopoint);
+                        trace_address(TRACE_STAR, NULL, &epoint, s->addr, star);
                         fixeddig = false;
                     }
                     s->addr = star;
                     star_tree = &s->tree; lvline = vline = 0;
                     xlin = lin = lpoint.line; apoint = lpoint;
-                    lentmp = strlen((char *)pline) + 1;
-                    expr = (uint8_t *)mallocx(lentmp);
-                    memcpy(expr, pline, lentmp); label = NULL;
+                    if (get_lcache(cfile) != NULL) { /* unmodified source line, it stays */
+                        expr = NULL;
+                        forline = pline;
+                    } else {
+                        lentmp = strlen((char *)pline) + 1;
+                        expr = (uint8_t *)mallocx(lentmp);
+                        memcpy(expr, pline, lentmp);
+                        forline = expr;
+                    }
+                    label = NULL;
                     new_waitfor(W_NEXT2, &epoint);
                     waitfor->breakout = false;
                     for (;;) {
@@ -2790,7 +2960,7 @@ Obj *compile(struct file_list_s *cflist)
                         waitfor->skip = 1;lvline = vline;
                         nf = compile(cflist);
                         xlin = lpoint.line;
-                        pline = expr;
+                        pline = forline;
                         lpoint.line = lin;
                         if (nf == NULL || waitfor->breakout) break;
                         if (nopos > 0) {
@@ -3063,6 +3233,7 @@ Obj *compile(struct file_list_s *cflist)
                             restart_memblocks(&tmp3->mem, tmp3->address);
                             if (diagnostics.optimize) cpu_opt_invalidate();
                             if (fixeddig && pass > max_pass) err_msg_cant_calculate(NULL, &epoint);
+                            trace_change(TRACE_SECTION, &sectionname, &epoint, NULL, NULL);
                             fixeddig = false;
                         }
                         tmp3->provides = ~(uval_t)0;tmp3->requires = tmp3->conflicts = 0;
@@ -3087,6 +3258,7 @@ Obj *compile(struct file_list_s *cflist)
                             tmp3->restart = current_section->address;
                             if (tmp3->l_restart.address != current_section->l_address.address ||
                                     tmp3->l_restart.bank != current_section->l_address.bank) {
+                                trace_address(TRACE_SECTION, &sectionname, &epoint, (tmp3->l_restart.address & 0xffff) | tmp3->l_restart.bank, (current_section->l_address.address & 0xffff) | current_section->l_address.bank);
                                 tmp3->l_restart = current_section->l_address;
                                 if (fixeddig && pass > max_pass) err_msg_cant_calculate(NULL, &epoint);
                                 fixeddig = false;
@@ -3102,6 +3274,7 @@ Obj *compile(struct file_list_s *cflist)
                             tmp3->l_address = current_section->l_address;
                             if (tmp3->l_restart.address != current_section->l_address.address ||
                                     tmp3->l_restart.bank != current_section->l_address.bank) {
+                                trace_address(TRACE_SECTION, &sectionname, &epoint, (tmp3->l_restart.address & 0xffff) | tmp3->l_restart.bank, (current_section->l_address.address & 0xffff) | current_section->l_address.bank);
                                 tmp3->l_restart = current_section->l_address;
                                 if (fixeddig && pass > max_pass) err_msg_cant_calculate(NULL, &epoint);
                                 fixeddig = false;
@@ -3132,6 +3305,7 @@ Obj *compile(struct file_list_s *cflist)
                         tmp->end = tmp->start = tmp->restart = tmp->address = 0;
                         tmp->size = tmp->l_restart.address = tmp->l_restart.bank = tmp->l_address.address = tmp->l_address.bank = 0;
                         if (fixeddig && pass > max_pass) err_msg_cant_calculate(&sectionname, &epoint);
+                        trace_change(TRACE_SECTION, &sectionname, &epoint, NULL, NULL);
                         fixeddig = false;
                         tmp->defpass = pass - 1;
                         restart_memblocks(&tmp->mem, tmp->address);
@@ -3386,14 +3560,18 @@ static int main2(int argc, char *argv[]) {
              "are welcome to redistribute it under certain conditions; See LICENSE!\n");
     }
 
+    if (arguments.labelcache != NULL) labelcache_load(fin, argc - opts, argv + opts);
+
     /* assemble the input file(s) */
     do {
         if (pass++>max_pass) {err_msg(ERROR_TOO_MANY_PASS, NULL);break;}
+        if (pass > 1) garbage_collect_pass();
+        profile_pass_begin();
         listing_pccolumn = false; fixeddig = true;constcreated = false;error_reset();random_reseed(&int_value[0]->v, NULL);
         restart_memblocks(&root_section.mem, 0);
         if (diagnostics.optimize) cpu_opt_invalidate();
         for (i = opts - 1; i<argc; i++) {
-            set_cpumode(arguments.cpumode); if (pass == 1 && i == opts - 1) constcreated = false;
+            set_cpumode(arguments.cpumode);
             star = databank = dpage = strength = 0;longaccu = longindex = autosize = false;actual_encoding = new_encoding(&none_enc);
             allowslowbranch = true;temporary_label_branch = 0;
             reset_waitfor();lpoint.line = vline = 0;outputeor = 0;forwr = backr = 0;
@@ -3407,7 +3585,9 @@ static int main2(int argc, char *argv[]) {
                     cflist = enterfile(fin, &nopoint);
                     star_tree = &fin->star;
                     reffile = fin->uid;
+                    profile_enter(PROFILE_FILE, fin, 0);
                     compile(cflist);
+                    profile_exit();
                     exitfile();
                 }
                 restart_memblocks(&root_section.mem, 0);
@@ -3419,11 +3599,15 @@ static int main2(int argc, char *argv[]) {
                 cflist = enterfile(cfile, &nopoint);
                 star_tree = &cfile->star;
                 reffile = cfile->uid;
+                profile_enter(PROFILE_FILE, cfile, 0);
                 compile(cflist);
+                profile_exit();
                 closefile(cfile);
                 exitfile();
             }
         }
+        if (pass == 1 && arguments.labelcache != NULL) labelcache_unseed();
+        profile_pass_end(pass, false);
         /*garbage_collect();*/
     } while (!fixeddig || constcreated);
     if (diagnostics.shadow) shadow_check(root_namespace);
@@ -3437,6 +3621,8 @@ static int main2(int argc, char *argv[]) {
         fixeddig = true;constcreated = false;error_reset();random_reseed(&int_value[0]->v, NULL);
         restart_memblocks(&root_section.mem, 0);
         if (diagnostics.optimize) cpu_opt_invalidate();
+        garbage_collect_pass();
+        profile_pass_begin();
         listing_open(arguments.list, argc, argv);
         for (i = opts - 1; i<argc; i++) {
             set_cpumode(arguments.cpumode);
@@ -3454,7 +3640,9 @@ static int main2(int argc, char *argv[]) {
                     star_tree = &fin->star;
                     reffile = fin->uid;
                     listing_file(";******  Command line definitions", NULL);
+                    profile_enter(PROFILE_FILE, fin, 0);
                     compile(cflist);
+                    profile_exit();
                     exitfile();
                 }
                 restart_memblocks(&root_section.mem, 0);
@@ -3468,23 +3656,28 @@ static int main2(int argc, char *argv[]) {
                 star_tree = &cfile->star;
                 reffile = cfile->uid;
                 listing_file(";******  Processing input file: ", argv[i]);
+                profile_enter(PROFILE_FILE, cfile, 0);
                 compile(cflist);
+                profile_exit();
                 closefile(cfile);
                 exitfile();
             }
         }
         /*garbage_collect();*/
         listing_close(arguments.list);
+        profile_pass_end(pass, true);
     }
 
     set_cpumode(arguments.cpumode);
 
     if (arguments.label != NULL) labelprint();
     if (arguments.make != NULL) makefile(argc - opts, argv + opts);
+    profile_write();
 
     if (error_serious()) {status();return EXIT_FAILURE;}
 
     output_mem(&root_section.mem);
+    if (arguments.labelcache != NULL && !error_serious()) labelcache_save(fin, argc - opts, argv + opts);
 
     {
         bool e = error_serious();
@@ -3555,13 +3748,10 @@ int wmain(int argc, wchar_t *argv2[]) {
     return r;
 }
 #else
-int main(int argc, char *argv[]) {
+static int main3(int argc, char *argv[]) {
     int i, r;
     char **uargv;
 
-    setlocale(LC_ALL, "");
-    setlocale(LC_NUMERIC, "C");
-
     uargv = (char **)malloc(argc * sizeof *uargv);
     if (uargv == NULL) err_msg_out_of_memory2();
     for (i = 0; i < argc; i++) {
@@ -3601,6 +3791,363 @@ int main(int argc, char *argv[]) {
     free(uargv);
     return r;
 }
+
+#ifdef SERVER_MODE
+static char *server_line(FILE *f) {
+    size_t len = 0, max = 256;
+    int c;
+    char *s = (char *)malloc(max);
+    if (s == NULL) err_msg_out_of_memory2();
+    while ((c = getc(f)) != EOF && c != '\n') {
+        if (len + 1 >= max) {
+            max += 1024;
+            if (max < 1024) err_msg_out_of_memory2(); /* overflow */
+            s = (char *)realloc(s, max);
+            if (s == NULL) err_msg_out_of_memory2();
+        }
+        s[len++] = c;
+    }
+    if (c == EOF && len == 0) {
+        free(s);
+        return NULL;
+    }
+    s[len] = 0;
+    return s;
+}
+
+/* Split request into arguments in place, with "" quoting and \ escapes.
+   An argument starting with an unquoted # comments out the rest. */
+static int server_split(char *s, char *argv[]) {
+    int argc = 1;
+    char *d = s;
+    for (;;) {
+        bool quote = false;
+        while (*s == ' ' || *s == '\t' || *s == '\r') s++;
+        if (*s == 0 || *s == '#') break;
+        argv[argc++] = d;
+        for (; *s != 0; s++) {
+            if (*s == '\\' && s[1] != 0) *d++ = *++s;
+            else if (*s == '"') quote = !quote;
+            else if (!quote && (*s == ' ' || *s == '\t' || *s == '\r')) break;
+            else *d++ = *s;
+        }
+        if (*s != 0) s++;
+        *d++ = 0;
+    }
+    argv[argc] = NULL;
+    return argc;
+}
+
+struct job_s {
+    char *line;
+    char **argv;
+    int argc;
+    pid_t pid;
+    int status;
+    bool done;
+    bool quiet;
+    FILE *out, *err, *report;
+};
+
+/* Whether -q is given, the exit status is not printed for such jobs */
+static bool quiet_arg(int argc, char *argv[]) {
+    int i;
+    for (i = 1; i < argc && strcmp(argv[i], "--") != 0; i++) {
+        const char *s = argv[i];
+        if (s[0] != '-') continue;
+        if (s[1] == '-') {
+            if (s[2] != 0 && strncmp(s, "--quiet", strlen(s)) == 0) return true;
+            continue;
+        }
+        for (s++; *s != 0 && strchr("lLIMoDEW", *s) == NULL; s++) { /* up to one with an argument */
+            if (*s == 'q') return true;
+        }
+    }
+    return false;
+}
+
+static bool job_parse(struct job_s *job, char *line) {
+    job->line = line;
+    job->argv = (char **)malloc((strlen(line) / 2 + 3) * sizeof *job->argv);
+    if (job->argv == NULL) err_msg_out_of_memory2();
+    job->argv[0] = (char *)"64tass";
+    job->argc = server_split(line, job->argv);
+    job->quiet = quiet_arg(job->argc, job->argv);
+    if (job->argc > 1) return true;
+    free(job->argv);
+    free(line);
+    return false;
+}
+
+/* Assemble in a forked child, the output is optionally captured */
+static void job_start(struct job_s *job, bool capture) {
+    job->pid = -1;
+    job->status = EXIT_FAILURE;
+    job->done = false;
+    job->out = job->err = NULL;
+    fflush(stdout);
+    fflush(stderr);
+    job->report = tmpfile();
+    if (capture && job->report != NULL) {
+        job->out = tmpfile();
+        job->err = tmpfile();
+        if (job->out == NULL || job->err == NULL) {
+            if (job->out != NULL) fclose(job->out);
+            if (job->err != NULL) fclose(job->err);
+            job->out = job->err = NULL;
+            fclose(job->report);
+            job->report = NULL;
+        }
+    }
+    if (job->report != NULL) job->pid = fork();
+    if (job->pid == 0) {
+        if (freopen("/dev/null", "rb", stdin) == NULL) _exit(EXIT_FAILURE);
+        if (capture) {
+            dup2(fileno(job->out), STDOUT_FILENO);
+            dup2(fileno(job->err), STDERR_FILENO);
+        }
+        file_report(job->report);
+        exit(main3(job->argc, job->argv));
+    }
+    if (job->pid < 0) {
+        perror("64tass");
+        job->done = true;
+    }
+}
+
+/* Collect the sources used by a finished child into the cache */
+static void job_finish(struct job_s *job, int st) {
+    char *s;
+    job->status = WIFEXITED(st) ? WEXITSTATUS(st) : EXIT_FAILURE;
+    job->done = true;
+    if (job->report == NULL) return;
+    rewind(job->report);
+    while ((s = server_line(job->report)) != NULL) {
+        int toascii, n = 0;
+        unsigned int hash;
+        if (sscanf(s, "%d %8x %n", &toascii, &hash, &n) == 2 && n != 0) {
+            file_cache_add(s + n, toascii != 0, hash);
+        }
+        free(s);
+    }
+    fclose(job->report);
+    job->report = NULL;
+}
+
+static void job_copy(FILE *f, FILE *to) {
+    char buffer[BUFSIZ];
+    size_t l;
+    if (f == NULL) return;
+    rewind(f);
+    while ((l = fread(buffer, 1, sizeof buffer, f)) != 0) {
+        fwrite(buffer, 1, l, to);
+    }
+    fclose(f);
+}
+
+static void job_free(struct job_s *job) {
+    if (job->report != NULL) fclose(job->report);
+    if (job->out != NULL) fclose(job->out);
+    if (job->err != NULL) fclose(job->err);
+    free(job->argv);
+    free(job->line);
+}
+
+/* Assemble each request line in a forked child. Decoded sources are
+   cached here, so that children only need to check their content. */
+static int server(void) {
+    char *line;
+
+    setvbuf(stdin, NULL, _IONBF, 0); /* children must not consume requests */
+    file_cache_init();
+    while ((line = server_line(stdin)) != NULL) {
+        struct job_s job;
+        int st;
+
+        if (!job_parse(&job, line)) continue;
+        job_start(&job, false);
+        if (job.pid > 0 && waitpid(job.pid, &st, 0) == job.pid) {
+            printf("Exit status:       %d\n", WIFEXITED(st) ? WEXITSTATUS(st) : EXIT_FAILURE);
+            fflush(stdout);
+            job_finish(&job, st);
+        } else {
+            printf("Exit status:       %d\n", EXIT_FAILURE);
+            fflush(stdout);
+        }
+        job_free(&job);
+    }
+    file_cache_destroy();
+    return EXIT_SUCCESS;
+}
+
+/* Run jobs on as many processes as there are processors. With warm set
+   the first one runs alone, to have the sources decoded for the rest.
+   Outputs are printed in job order once finished. */
+static int run_jobs(struct job_s *jobs, size_t n, bool warm) {
+    size_t i, next = 0, printed = 0, running = 0, workers = 1;
+    bool failed = false;
+#ifdef _SC_NPROCESSORS_ONLN
+    long c = sysconf(_SC_NPROCESSORS_ONLN);
+    if (c > 1) workers = c;
+#endif
+
+    file_cache_init();
+    while (printed < n) {
+        while (running < ((warm && printed == 0) ? 1 : workers) && next < n) {
+            job_start(&jobs[next], true);
+            if (jobs[next].pid > 0) running++;
+            next++;
+        }
+        if (running != 0) {
+            int st;
+            pid_t pid = waitpid(-1, &st, 0);
+            if (pid < 0) break;
+            for (i = printed; i < next; i++) {
+                if (jobs[i].pid != pid || jobs[i].done) continue;
+                job_finish(&jobs[i], st);
+                running--;
+                break;
+            }
+        }
+        for (; printed < next && jobs[printed].done; printed++) {
+            struct job_s *job = &jobs[printed];
+            fflush(stderr);
+            job_copy(job->out, stdout);
+            fflush(stdout);
+            job_copy(job->err, stderr);
+            fflush(stderr);
+            job->out = job->err = NULL;
+            if (!job->quiet) printf("Exit status:       %d\n", job->status);
+            if (job->status != EXIT_SUCCESS) failed = true;
+        }
+    }
+    for (i = 0; i < n; i++) job_free(&jobs[i]);
+    free(jobs);
+    file_cache_destroy();
+    return (failed || printed < n) ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+/* Run the jobs of a file in parallel */
+static int batch(const char *name) {
+    struct job_s *jobs = NULL;
+    size_t n = 0;
+    char *line;
+    FILE *f = fopen(name, "rb");
+
+    if (f == NULL) {
+        perror(name);
+        return EXIT_FAILURE;
+    }
+    while ((line = server_line(f)) != NULL) {
+        if ((n & 15) == 0) {
+            jobs = (struct job_s *)realloc(jobs, (n + 16) * sizeof *jobs);
+            if (jobs == NULL) err_msg_out_of_memory2();
+        }
+        if (job_parse(&jobs[n], line)) n++;
+    }
+    fclose(f);
+    return run_jobs(jobs, n, false);
+}
+
+static const char *variant_arg(int argc, char *argv[], int *i) {
+    if (*i >= argc) return NULL;
+    if (strncmp(argv[*i], "--variant=", 10) == 0) return argv[*i] + 10;
+    if (strcmp(argv[*i], "--variant") == 0 && *i + 1 < argc) return argv[++*i];
+    return NULL;
+}
+
+/* Symbol defined by a -D option, the length is up to the "=" */
+static const char *define_arg(int argc, char *argv[], int *i, size_t *len) {
+    const char *d;
+    if (*i >= argc || strncmp(argv[*i], "-D", 2) != 0) return NULL;
+    if (argv[*i][2] != 0) d = argv[*i] + 2;
+    else if (*i + 1 < argc) d = argv[++*i];
+    else return NULL;
+    *len = strcspn(d, "=");
+    return d;
+}
+
+/* Whether the symbol of a -D is defined by the variant as well */
+static bool define_overridden(const char *d, size_t len, int argc, char *argv[]) {
+    int i;
+    for (i = 1; i < argc; i++) {
+        size_t len2;
+        const char *d2 = define_arg(argc, argv, &i, &len2);
+        if (d2 != NULL && len2 == len && memcmp(d, d2, len) == 0) return true;
+    }
+    return false;
+}
+
+/* Assemble the command line as it is and once more for each --variant,
+   with the options of the variant added before "--" if there's one. A -D
+   of the variant replaces the one of the same symbol on the command line.
+   The sources are decoded by the first assembly, the rest are run in
+   parallel and reuse it. */
+static int matrix(int argc, char *argv[]) {
+    struct job_s *jobs;
+    size_t n = 0;
+    int i, j, base = 0, end = 1;
+
+    while (end < argc && strcmp(argv[end], "--") != 0) end++;
+    jobs = (struct job_s *)malloc((argc + 1) * sizeof *jobs);
+    if (jobs == NULL) err_msg_out_of_memory2();
+    for (i = 1; i < argc; i++) {
+        if (variant_arg(end, argv, &i) == NULL) base++;
+    }
+    for (i = 0; i < end; i++) {
+        const char *v = (i != 0) ? variant_arg(end, argv, &i) : "";
+        struct job_s *job = &jobs[n];
+        size_t len;
+        char **vargv;
+        int vargc;
+        if (v == NULL) continue;
+        len = strlen(v) + 1;
+        job->line = (char *)malloc(len);
+        if (job->line == NULL) err_msg_out_of_memory2();
+        memcpy(job->line, v, len);
+        vargv = (char **)malloc((len / 2 + 3) * sizeof *vargv);
+        job->argv = (char **)malloc((len / 2 + 3 + base) * sizeof *job->argv);
+        if (vargv == NULL || job->argv == NULL) err_msg_out_of_memory2();
+        vargc = server_split(job->line, vargv);
+        job->argc = 0;
+        for (j = 0; j < end; j++) {
+            int k = j;
+            size_t dlen;
+            const char *d;
+            if (j != 0 && variant_arg(end, argv, &j) != NULL) continue;
+            d = define_arg(end, argv, &j, &dlen);
+            if (d != NULL && define_overridden(d, dlen, vargc, vargv)) continue;
+            for (; k <= j; k++) job->argv[job->argc++] = argv[k];
+        }
+        memcpy(job->argv + job->argc, vargv + 1, (vargc - 1) * sizeof *vargv);
+        job->argc += vargc - 1;
+        for (j = end; j < argc; j++) job->argv[job->argc++] = argv[j];
+        job->argv[job->argc] = NULL;
+        job->quiet = quiet_arg(job->argc, job->argv);
+        free(vargv);
+        n++;
+    }
+    return run_jobs(jobs, n, true);
+}
+#endif
+
+int main(int argc, char *argv[]) {
+    setlocale(LC_ALL, "");
+    setlocale(LC_NUMERIC, "C");
+
+#ifdef SERVER_MODE
+    if (argc == 2 && strcmp(argv[1], "--server") == 0) return server();
+    if (argc == 2 && strncmp(argv[1], "--batch=", 8) == 0) return batch(argv[1] + 8);
+    if (argc == 3 && strcmp(argv[1], "--batch") == 0) return batch(argv[2]);
+    {
+        int i;
+        for (i = 1; i < argc && strcmp(argv[i], "--") != 0; i++) {
+            if (variant_arg(argc, argv, &i) != NULL) return matrix(argc, argv);
+        }
+    }
+#endif
+    return main3(argc, argv);
+}
 #endif
 
 
@@ -38,13 +38,19 @@ struct arguments_s arguments = {
     false,       /* longaddr */
     false,       /* tasmcomp */
     false,       /* verbose */
+    false,       /* timereport */
+    false,       /* tracepasses */
+    false,       /* memstats */
     0x20,        /* caseinsensitive */
     "a.out",     /* output */
     &c6502,      /* cpumode */
     NULL,        /* label */
+    NULL,        /* labelcache */
     NULL,        /* list */
     NULL,        /* make */
     NULL,        /* error */
+    NULL,        /* profile */
+    NULL,        /* profilestacks */
     OUTPUT_CBM,  /* output_mode */
     8,           /* tab_size */
     LABEL_64TASS /* label_mode */
@@ -210,6 +216,7 @@ static const struct my_option long_options[] = {
     {"error"            , my_required_argument, NULL, 'E'},
     {"vice-labels"      , my_no_argument      , NULL,  0x10b},
     {"dump-labels"      , my_no_argument      , NULL,  0x10d},
+    {"label-cache"      , my_required_argument, NULL,  0x113},
     {"list"             , my_required_argument, NULL, 'L'},
     {"verbose-list"     , my_no_argument      , NULL,  0x110},
     {"no-monitor"       , my_no_argument      , NULL, 'm'},
@@ -217,6 +224,14 @@ static const struct my_option long_options[] = {
     {"line-numbers"     , my_no_argument      , NULL,  0x112},
     {"no-caret-diag"    , my_no_argument      , NULL,  0x10a},
     {"tab-size"         , my_required_argument, NULL,  0x109},
+    {"server"           , my_no_argument      , NULL,  0x114},
+    {"batch"            , my_required_argument, NULL,  0x115},
+    {"variant"          , my_required_argument, NULL,  0x116},
+    {"time-report"      , my_no_argument      , NULL,  0x117},
+    {"profile"          , my_required_argument, NULL,  0x118},
+    {"profile-stacks"   , my_required_argument, NULL,  0x119},
+    {"trace-passes"     , my_no_argument      , NULL,  0x11a},
+    {"mem-stats"        , my_no_argument      , NULL,  0x11b},
     {"version"          , my_no_argument      , NULL, 'V'},
     {"usage"            , my_no_argument      , NULL,  0x102},
     {"help"             , my_no_argument      , NULL,  0x103},
@@ -284,6 +299,7 @@ int testarg(int argc,char *argv[], struct file_s *fin) {
         case 'l': arguments.label = my_optarg;break;
         case 0x10b: arguments.label_mode = LABEL_VICE; break;
         case 0x10d: arguments.label_mode = LABEL_DUMP; break;
+        case 0x113: arguments.labelcache = my_optarg; break;
         case 'E': arguments.error = my_optarg;break;
         case 'L': arguments.list = my_optarg;break;
         case 'M': arguments.make = my_optarg;break;
@@ -293,6 +309,20 @@ int testarg(int argc,char *argv[], struct file_s *fin) {
         case 0x112: arguments.linenum = true;break;
         case 'C': arguments.caseinsensitive = 0;break;
         case 0x110: arguments.verbose = true;break;
+        case 0x117: arguments.timereport = true;break;
+        case 0x118: arguments.profile = my_optarg;break;
+        case 0x119: arguments.profilestacks = my_optarg;break;
+        case 0x11a: arguments.tracepasses = true;break;
+        case 0x11b: arguments.memstats = true;break;
+        case 0x114:
+        case 0x115:
+            printable_print((const uint8_t *)argv[0], stderr);
+            fputs((opt == 0x114) ? ": option '--server' must be used alone\n" : ": option '--batch' must be used alone\n", stderr);
+            goto exit;
+        case 0x116:
+            printable_print((const uint8_t *)argv[0], stderr);
+            fputs(": option '--variant' is not supported on this platform\n", stderr);
+            goto exit;
         case 0x109:tab = atoi(my_optarg); if (tab > 0 && tab <= 64) arguments.tab_size = tab; break;
         case 0x102:puts(
          /* 12345678901234567890123456789012345678901234567890123456789012345678901234567890 */
@@ -303,10 +333,13 @@ int testarg(int argc,char *argv[], struct file_s *fin) {
            "        [--tasm-compatible] [--quiet] [--no-warn] [--long-address] [--m65c02]\n"
            "        [--m6502] [--m65xx] [--m65dtv02] [--m65816] [--m65el02] [--mr65c02]\n"
            "        [--mw65c02] [--m65ce02] [--m4510] [--labels=<file>] [--vice-labels]\n"
-           "        [--dump-labels] [--list=<file>] [--no-monitor] [--no-source]\n"
-           "        [--line-numbers] [--tab-size=<value>] [--verbose-list] [-W<option>]\n"
-           "        [--errors=<file>] [--output=<file>] [--help] [--usage]\n"
-           "        [--version] SOURCES");
+           "        [--dump-labels] [--label-cache=<file>] [--list=<file>]\n"
+           "        [--no-monitor] [--no-source] [--line-numbers] [--tab-size=<value>]\n"
+           "        [--verbose-list] [--time-report] [--profile=<file>]\n"
+           "        [--profile-stacks=<file>] [--trace-passes] [--mem-stats]\n"
+           "        [-W<option>] [--errors=<file>] [--output=<file>] [--help]\n"
+           "        [--usage] [--version] [--server] [--batch=<file>]\n"
+           "        [--variant=<options>] SOURCES");
                return 0;
 
         case 'V':puts("64tass Turbo Assembler Macro V" VERSION);
@@ -327,6 +360,12 @@ int testarg(int argc,char *argv[], struct file_s *fin) {
            "  -T, --tasm-compatible Enable TASM compatible mode\n"
            "  -w, --no-warn         Suppress warnings\n"
            "      --no-caret-diag   Suppress source line display\n"
+           "      --time-report     Print time spent in passes and macros\n"
+           "      --profile=<file>  Source line hot spots into <file>\n"
+           "      --profile-stacks=<f>\n"
+           "                        Collapsed call stacks into <f>\n"
+           "      --trace-passes    Print what changed in each pass\n"
+           "      --mem-stats       Print memory use per pass and type\n"
            "\n"
            " Diagnostic options:\n"
            "  -Wall                 Enable most diagnostic warnings\n"
@@ -373,6 +412,7 @@ int testarg(int argc,char *argv[], struct file_s *fin) {
            "  -l, --labels=<file>   List labels into <file>\n"
            "      --vice-labels     Labels in VICE format\n"
            "      --dump-labels     Dump for debugging\n"
+           "      --label-cache=<f> Seed first pass from label cache\n"
            "  -L, --list=<file>     List into <file>\n"
            "  -m, --no-monitor      Don't put monitor code into listing\n"
            "  -s, --no-source       Don't put source code into listing\n"
@@ -384,6 +424,9 @@ int testarg(int argc,char *argv[], struct file_s *fin) {
            "  -?, --help            Give this help list\n"
            "      --usage           Give a short usage message\n"
            "  -V, --version         Print program version\n"
+           "      --server          Assemble requests read from stdin\n"
+           "      --batch=<file>    Assemble command lines of <file> in parallel\n"
+           "      --variant=<opts>  Also assemble with these options added\n"
            "\n"
            "Mandatory or optional arguments to long options are also mandatory or optional\n"
            "for any corresponding short options.\n"
@@ -44,13 +44,19 @@ struct arguments_s {
     bool longaddr;
     bool tasmcomp;
     bool verbose;
+    bool timereport;
+    bool tracepasses;
+    bool memstats;
     uint8_t caseinsensitive;
     const char *output;
     const struct cpu_s *cpumode;
     const char *label;
+    const char *labelcache;
     const char *list;
     const char *make;
     const char *error;
+    const char *profile;
+    const char *profilestacks;
     enum output_mode_e output_mode;
     uint8_t tab_size;
     enum label_mode_e label_mode;
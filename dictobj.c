@@ -34,39 +34,90 @@ static Type obj;
 
 Type *DICT_OBJ = &obj;
 
-static void dict_free(struct avltree_node *aa)
-{
-    struct pair_s *a = avltree_container_of(aa, struct pair_s, node);
-    val_destroy(a->key);
-    if (a->data != NULL) val_destroy(a->data);
-    free(a);
+static struct oper_s pair_oper;
+
+static bool pair_equal(Obj *a, Obj *b) {
+    Obj *result;
+    bool eq;
+    pair_oper.v1 = a;
+    pair_oper.v2 = b;
+    result = pair_oper.v1->obj->calc2(&pair_oper);
+    eq = (result->obj == INT_OBJ) ? ((Int *)result)->len == 0 : a->obj->type == b->obj->type;
+    val_destroy(result);
+    return eq;
 }
 
-static void dict_free2(struct avltree_node *aa)
-{
-    struct pair_s *a = avltree_container_of(aa, struct pair_s, node);
-    free(a);
+static inline size_t dict_slot(const Dict *dict, int hash) {
+    unsigned int h = (unsigned int)hash;
+    return (h ^ (h >> 11) ^ (h >> 22)) & dict->mask;
 }
 
-static void dict_garbage1(struct avltree_node *aa)
-{
-    struct pair_s *a = avltree_container_of(aa, struct pair_s, node);
-    a->key->refcount--;
-    if (a->data != NULL) a->data->refcount--;
+/* Index slot of the key, or the free one where it would go */
+static size_t empty_index = SIZE_MAX;
+
+static size_t *dict_lookup(const Dict *dict, int hash, Obj *key) {
+    size_t i;
+    if (dict->index == NULL) return &empty_index;
+    for (i = dict_slot(dict, hash); dict->index[i] != SIZE_MAX; i = (i + 1) & dict->mask) {
+        const struct pair_s *p = &dict->data[dict->index[i]];
+        if (p->hash == hash && pair_equal(p->key, key)) break;
+    }
+    return &dict->index[i];
 }
 
-static void dict_garbage2(struct avltree_node *aa)
-{
-    struct pair_s *a = avltree_container_of(aa, struct pair_s, node);
-    Obj *v;
-    v = a->data;
-    if (v != NULL) {
-        if ((v->refcount & SIZE_MSB) != 0) {
-            v->refcount -= SIZE_MSB - 1;
-            v->obj->garbage(v, 1);
-        } else v->refcount++;
+/* At most three quarters of the index is used */
+static inline size_t dict_capacity(size_t mask) {
+    return mask + 1 - ((mask + 1) >> 2);
+}
+
+void dict_reserve(Dict *dict, size_t len) {
+    size_t i, size = 8;
+    if (dict->index != NULL && len <= dict_capacity(dict->mask)) return;
+    while (dict_capacity(size - 1) < len) {
+        size *= 2;
+        if (size == 0 || size > SIZE_MAX / sizeof *dict->index || size > SIZE_MAX / sizeof *dict->data) err_msg_out_of_memory(); /* overflow */
+    }
+    free(dict->index);
+    dict->mask = size - 1;
+    dict->data = (struct pair_s *)reallocx(dict->data, dict_capacity(dict->mask) * sizeof *dict->data);
+    dict->index = (size_t *)mallocx(size * sizeof *dict->index);
+    for (i = 0; i < size; i++) dict->index[i] = SIZE_MAX;
+    for (i = 0; i < dict->len; i++) {
+        size_t j;
+        for (j = dict_slot(dict, dict->data[i].hash); dict->index[j] != SIZE_MAX; j = (j + 1) & dict->mask);
+        dict->index[j] = i;
+    }
+}
+
+/* Later values of the same key replace earlier ones, but the position of
+   the first one is kept */
+MUST_CHECK Error *dict_insert(Dict *dict, Obj *key, Obj *data, linepos_t epoint) {
+    struct pair_s *p;
+    size_t *b;
+    int hash;
+    Error *err = key->obj->hash(key, &hash, epoint);
+    if (err != NULL) return err;
+    b = dict_lookup(dict, hash, key);
+    if (*b != SIZE_MAX) {
+        p = &dict->data[*b];
+        if (p->data != NULL) val_destroy(p->data);
+        p->data = val_reference(data);
+        return NULL;
+    }
+    if (dict->index == NULL || dict->len >= dict_capacity(dict->mask)) {
+        if (dict->len >= SIZE_MAX / 2) err_msg_out_of_memory(); /* overflow */
+        dict_reserve(dict, dict->len * 2 + 1);
+        b = dict_lookup(dict, hash, key);
     }
-    v = a->key;
+    *b = dict->len;
+    p = &dict->data[dict->len++];
+    p->hash = hash;
+    p->key = val_reference(key);
+    p->data = val_reference(data);
+    return NULL;
+}
+
+static inline void pair_garbage(Obj *v) {
     if ((v->refcount & SIZE_MSB) != 0) {
         v->refcount -= SIZE_MSB - 1;
         v->obj->garbage(v, 1);
@@ -86,54 +137,59 @@ static MUST_CHECK Obj *create(Obj *v1, linepos_t epoint) {
 
 static void destroy(Obj *o1) {
     Dict *v1 = (Dict *)o1;
-    avltree_destroy(&v1->members, dict_free);
+    size_t i;
+    for (i = 0; i < v1->len; i++) {
+        struct pair_s *a = &v1->data[i];
+        val_destroy(a->key);
+        if (a->data != NULL) val_destroy(a->data);
+    }
+    free(v1->data);
+    free(v1->index);
     if (v1->def != NULL) val_destroy(v1->def);
 }
 
 static void garbage(Obj *o1, int i) {
     Dict *v1 = (Dict *)o1;
-    Obj *v;
+    size_t j;
     switch (i) {
     case -1:
-        avltree_destroy(&v1->members, dict_garbage1);
-        v = v1->def;
-        if (v != NULL) v->refcount--;
+        for (j = 0; j < v1->len; j++) {
+            struct pair_s *a = &v1->data[j];
+            a->key->refcount--;
+            if (a->data != NULL) a->data->refcount--;
+        }
+        if (v1->def != NULL) v1->def->refcount--;
         return;
     case 0:
-        avltree_destroy(&v1->members, dict_free2);
+        free(v1->data);
+        free(v1->index);
         return;
     case 1:
-        avltree_destroy(&v1->members, dict_garbage2);
-        v = v1->def;
-        if (v == NULL) return;
-        if ((v->refcount & SIZE_MSB) != 0) {
-            v->refcount -= SIZE_MSB - 1;
-            v->obj->garbage(v, 1);
-        } else v->refcount++;
+        for (j = 0; j < v1->len; j++) {
+            struct pair_s *a = &v1->data[j];
+            if (a->data != NULL) pair_garbage(a->data);
+            pair_garbage(a->key);
+        }
+        if (v1->def != NULL) pair_garbage(v1->def);
         return;
     }
 }
 
 static bool same(const Obj *o1, const Obj *o2) {
     const Dict *v1 = (const Dict *)o1, *v2 = (const Dict *)o2;
-    const struct avltree_node *n;
-    const struct avltree_node *n2;
+    size_t i;
     if (o2->obj != DICT_OBJ || v1->len != v2->len) return false;
     if ((v1->def == NULL) != (v2->def == NULL)) return false;
     if (v1->def != NULL && v2->def != NULL && !v1->def->obj->same(v1->def, v2->def)) return false;
-    n = avltree_first(&v1->members);
-    n2 = avltree_first(&v2->members);
-    while (n != NULL && n2 != NULL) {
-        const struct pair_s *p, *p2;
-        if (pair_compare(n, n2) != 0) return false;
-        p = cavltree_container_of(n, struct pair_s, node);
-        p2 = cavltree_container_of(n2, struct pair_s, node);
+    for (i = 0; i < v1->len; i++) {
+        const struct pair_s *p = &v1->data[i], *p2;
+        size_t j = *dict_lookup(v2, p->hash, p->key);
+        if (j == SIZE_MAX) return false;
+        p2 = &v2->data[j];
         if ((p->data == NULL) != (p2->data == NULL)) return false;
         if (p->data != NULL && p2->data != NULL && !p->data->obj->same(p->data, p2->data)) return false;
-        n = avltree_next(n);
-        n2 = avltree_next(n2);
     }
-    return n == n2;
+    return true;
 }
 
 static MUST_CHECK Obj *len(Obj *o1, linepos_t UNUSED(epoint)) {
@@ -163,9 +219,9 @@ static MUST_CHECK Obj *repr(Obj *o1, linepos_t epoint, size_t maxsize) {
         list->data = vals = list_create_elements(list, ln);
         ln = chars;
         if (v1->len != 0) {
-            const struct avltree_node *n = avltree_first(&v1->members);
-            while (n != NULL) {
-                p = cavltree_container_of(n, struct pair_s, node);
+            size_t n;
+            for (n = 0; n < v1->len; n++) {
+                p = &v1->data[n];
                 v = p->key->obj->repr(p->key, epoint, maxsize - chars);
                 if (v == NULL || v->obj != STR_OBJ) goto error;
                 str = (Str *)v;
@@ -188,7 +244,6 @@ static MUST_CHECK Obj *repr(Obj *o1, linepos_t epoint, size_t maxsize) {
                     chars--;
                 }
                 vals[i++] = v;
-                n = avltree_next(n);
             }
         }
         if (def != 0) {
@@ -243,8 +298,8 @@ static MUST_CHECK Obj *repr(Obj *o1, linepos_t epoint, size_t maxsize) {
 
 
 static MUST_CHECK Obj *slice(Obj *o1, oper_t op, size_t indx) {
-    struct pair_s pair;
-    const struct avltree_node *b;
+    int hash;
+    size_t b;
     Obj *o2 = op->v2;
     Dict *v1 = (Dict *)o1;
     Error *err;
@@ -260,13 +315,11 @@ static MUST_CHECK Obj *slice(Obj *o1, oper_t op, size_t indx) {
 
     if (o2->obj == NONE_OBJ) return val_reference(o2);
 
-    pair.key = o2;
-    err = pair.key->obj->hash(pair.key, &pair.hash, epoint2);
+    err = o2->obj->hash(o2, &hash, epoint2);
     if (err != NULL) return &err->v;
-    b = avltree_lookup(&pair.node, &v1->members, pair_compare);
-    if (b != NULL) {
-        const struct pair_s *p = cavltree_container_of(b, struct pair_s, node);
-        return val_reference(p->data);
+    b = *dict_lookup(v1, hash, o2);
+    if (b != SIZE_MAX) {
+        return val_reference(v1->data[b].data);
     }
     if (v1->def != NULL) {
         return val_reference(v1->def);
@@ -296,15 +349,12 @@ static MUST_CHECK Obj *rcalc2(oper_t op) {
     Dict *v2 = (Dict *)op->v2;
     Obj *o1 = op->v1;
     if (op->op == &o_IN) {
-        struct pair_s p;
-        struct avltree_node *b;
+        int hash;
         Error *err;
 
-        p.key = o1;
-        err = p.key->obj->hash(p.key, &p.hash, op->epoint);
+        err = o1->obj->hash(o1, &hash, op->epoint);
         if (err != NULL) return &err->v;
-        b = avltree_lookup(&p.node, &v2->members, pair_compare);
-        return truth_reference(b != NULL);
+        return truth_reference(*dict_lookup(v2, hash, o1) != SIZE_MAX);
     }
     switch (o1->obj->type) {
     case T_NONE:
@@ -317,25 +367,6 @@ static MUST_CHECK Obj *rcalc2(oper_t op) {
     return obj_oper_error(op);
 }
 
-static struct oper_s pair_oper;
-
-int pair_compare(const struct avltree_node *aa, const struct avltree_node *bb)
-{
-    const struct pair_s *a = cavltree_container_of(aa, struct pair_s, node);
-    const struct pair_s *b = cavltree_container_of(bb, struct pair_s, node);
-    Obj *result;
-    int h = a->hash - b->hash;
-
-    if (h != 0) return h;
-    pair_oper.v1 = a->key;
-    pair_oper.v2 = b->key;
-    result = pair_oper.v1->obj->calc2(&pair_oper);
-    if (result->obj == INT_OBJ) h = ((Int *)result)->len;
-    else h = pair_oper.v1->obj->type - pair_oper.v2->obj->type;
-    val_destroy(result);
-    return h;
-}
-
 void dictobj_init(void) {
     static struct linepos_s nopoint;
 
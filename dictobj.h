@@ -20,14 +20,21 @@
 #define DICTOBJ_H
 #include "obj.h"
 #include "values.h"
-#include "avl.h"
 
 extern struct Type *DICT_OBJ;
 
+struct pair_s {
+    int hash;
+    Obj *key;
+    Obj *data;
+};
+
 typedef struct Dict {
     Obj v;
     size_t len;
-    struct avltree members;
+    size_t mask;
+    struct pair_s *data; /* in insertion order */
+    size_t *index;       /* hash table of positions in data */
     Obj *def;
 } Dict;
 
@@ -36,16 +43,14 @@ extern void dictobj_names(void);
 
 static inline MUST_CHECK Dict *new_dict(void) {
     Dict *v = (Dict *)val_alloc(DICT_OBJ);
-    avltree_init(&v->members);
+    v->len = 0;
+    v->mask = 0;
+    v->data = NULL;
+    v->index = NULL;
+    v->def = NULL;
     return v;
 }
 
-struct pair_s {
-    int hash;
-    Obj *key;
-    Obj *data;
-    struct avltree_node node;
-};
-
-extern int pair_compare(const struct avltree_node *, const struct avltree_node *);
+extern void dict_reserve(Dict *, size_t);
+extern MUST_CHECK struct Error *dict_insert(Dict *, Obj *, Obj *, linepos_t);
 #endif
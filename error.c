@@ -159,6 +159,7 @@ bool print_use_color = false;
 #define ALIGN(v) (((v) + (sizeof(int *) - 1)) & ~(sizeof(int *) - 1))
 
 static unsigned int errors = 0, warnings = 0;
+static size_t messages = 0;
 
 static struct file_list_s file_list;
 static const struct file_list_s *included_from = &file_list;
@@ -234,6 +235,7 @@ static bool new_error_msg(enum severity_e severity, const struct file_list_s *fl
     struct errorentry_s *err;
     size_t line_len;
     bool dupl = close_error();
+    messages++;
     switch (severity) {
     case SV_NOTDEFGNOTE:
     case SV_NOTDEFLNOTE:
@@ -306,6 +308,10 @@ struct file_list_s *enterfile(struct file_s *file, linepos_t epoint) {
     return current_file_list;
 }
 
+const struct file_list_s *get_file_list(void) {
+    return current_file_list;
+}
+
 void exitfile(void) {
     if (current_file_list->parent != NULL) current_file_list = current_file_list->parent;
     curfile = (current_file_list->file != NULL) ? current_file_list->file->uid : 1;
@@ -394,6 +400,7 @@ static const char *terr_fatal[] = {
     "can't write label file ",
     "can't write make file ",
     "can't write error file ",
+    "can't write profile file ",
     "file recursion",
     "macro recursion too deep",
     "function recursion too deep",
@@ -1063,6 +1070,14 @@ bool error_print() {
     return errors != 0;
 }
 
+size_t error_messages(void) {
+    return messages;
+}
+
+size_t error_memory(void) {
+    return error_list.max;
+}
+
 void error_reset(void) {
     error_list.len = error_list.header_pos = 0;
     current_file_list = &file_list;
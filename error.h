@@ -111,8 +111,11 @@ extern void err_msg_label_left(linepos_t);
 extern void err_msg_branch_page(int, linepos_t);
 extern void err_msg_deprecated(enum errors_e, linepos_t);
 extern void error_reset(void);
+extern size_t error_memory(void);
+extern size_t error_messages(void);
 extern bool error_print(void);
 extern struct file_list_s *enterfile(struct file_s *, linepos_t);
+extern const struct file_list_s *get_file_list(void);
 extern void exitfile(void);
 extern void err_init(const char *);
 extern void err_destroy(void);
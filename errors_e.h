@@ -112,6 +112,7 @@ enum errors_e {
     ERROR_CANT_WRTE_LBL,
     ERROR_CANT_WRTE_MAK,
     ERROR_CANT_WRTE_ERR,
+    ERROR_CANT_WRTE_PRF,
     ERROR_FILERECURSION,
     ERROR__MACRECURSION,
     ERROR__FUNRECURSION,
@@ -33,6 +33,7 @@
 #include "values.h"
 #include "arguments.h"
 #include "optimizer.h"
+#include "profile.h"
 
 #include "floatobj.h"
 #include "boolobj.h"
@@ -263,6 +264,34 @@ static MUST_CHECK Obj *get_string(void) {
     return v;
 }
 
+static MUST_CHECK Obj *get_literal(struct file_s *cfile, linepos_t epoint) {
+    struct lcache_s *lcache = get_lcache(cfile);
+    linecpos_t pos = lpoint.pos;
+    size_t messages;
+    Obj *v;
+
+    if (lcache != NULL) {
+        linecpos_t end;
+        v = lcache_token(lcache, pos, &end);
+        if (v != NULL) {
+            lpoint.pos = end;
+            return v;
+        }
+        messages = error_messages();
+    } else messages = 0;
+
+    switch (here()) {
+    case '$': v = get_hex(epoint); break;
+    case '%': v = get_bin(epoint); break;
+    case '"':
+    case '\'': v = get_string(); break;
+    default: v = get_float(epoint); break;
+    }
+    /* only literals which were parsed without any diagnostics can be reused */
+    if (lcache != NULL && v->obj != ERROR_OBJ && messages == error_messages()) lcache_add_token(lcache, pos, lpoint.pos, v);
+    return v;
+}
+
 void touch_label(Label *tmp) {
     if (referenceit) tmp->ref = true;
     tmp->usepass = pass;
@@ -293,6 +322,7 @@ static MUST_CHECK Obj *get_star(linepos_t epoint) {
     tmp = new_star(vline, &labelexists);
     if (labelexists && tmp->addr != star) {
         if (fixeddig && pass > max_pass) err_msg_cant_calculate(NULL, epoint);
+        trace_address(TRACE_STAR, NULL, epoint, tmp->addr, star);
         fixeddig = false;
     }
     tmp->addr = star;
@@ -328,6 +358,87 @@ static inline void push_oper(Obj *val, linepos_t epoint) {
     eval->o_out[eval->outp++].epoint = *epoint;
 }
 
+enum rpn_e {
+    RPN_VALUE, RPN_LABEL, RPN_IDENT, RPN_ANON, RPN_ANONIDENT, RPN_STAR
+};
+
+static struct rpnfix_s {
+    size_t outp;
+    uint8_t type;
+    int32_t arg;
+    const struct atom_s *atom;
+} *rpnfix;
+static size_t rpnfixes, rpnfix_size;
+
+static void push_rpnfix(enum rpn_e type, int32_t arg, const struct atom_s *atom) {
+    if (rpnfixes >= rpnfix_size) {
+        rpnfix_size += 16;
+        if (/*rpnfix_size < 16 ||*/ rpnfix_size > SIZE_MAX / sizeof *rpnfix) err_msg_out_of_memory(); /* overflow */
+        rpnfix = (struct rpnfix_s *)reallocx(rpnfix, rpnfix_size * sizeof *rpnfix);
+    }
+    rpnfix[rpnfixes].outp = eval->outp - 1;
+    rpnfix[rpnfixes].type = type;
+    rpnfix[rpnfixes].atom = atom;
+    rpnfix[rpnfixes++].arg = arg;
+}
+
+static void push_label(const struct atom_s *atom, struct lident_s *cache, size_t len, linepos_t epoint) {
+    bool down;
+    Label *l;
+    Error *err;
+    str_t ident;
+    ident.data = pline + epoint->pos;
+    ident.len = len;
+    down = (ident.data[0] != '_');
+    l = down ? find_atom(atom, NULL, cache) : find_atom2(atom, cheap_context, cache);
+    if (l != NULL) {
+        touch_label(l);
+        if (down) l->shadowcheck = true;
+        push_oper(val_reference(l->value), epoint);
+        return;
+    }
+    err = new_error(ERROR___NOT_DEFINED, epoint);
+    err->u.notdef.ident = ident;
+    err->u.notdef.names = ref_namespace(down ? current_context : cheap_context);
+    err->u.notdef.down = down;
+    push_oper(&err->v, epoint);
+}
+
+static void push_ident(const struct atom_s *atom, struct lident_s *cache, size_t len, linepos_t epoint) {
+    Ident *idn = (Ident *)val_alloc(IDENT_OBJ);
+    idn->name.data = pline + epoint->pos;
+    idn->name.len = len;
+    idn->atom = atom;
+    idn->cache = cache;
+    idn->epoint = *epoint;
+    push_oper(&idn->v, epoint);
+}
+
+/* positive count for forward, negative for backward references */
+static void push_anon(int32_t count, linepos_t epoint) {
+    Label *l;
+    Error *err;
+    l = find_anonlabel((count > 0) ? (count - 1) : count);
+    if (l != NULL) {
+        touch_label(l);
+        push_oper(val_reference(l->value), epoint);
+        return;
+    }
+    err = new_error(ERROR___NOT_DEFINED, epoint);
+    err->u.notdef.ident.len = (size_t)((ssize_t)count);
+    err->u.notdef.ident.data = NULL;
+    err->u.notdef.names = ref_namespace(current_context);
+    err->u.notdef.down = true;
+    push_oper(&err->v, epoint);
+}
+
+static void push_anonident(int32_t count, linepos_t epoint) {
+    Anonident *anonident = (Anonident *)val_alloc(ANONIDENT_OBJ);
+    anonident->count = (count > 0) ? (count - 1) : count;
+    anonident->epoint = *epoint;
+    push_oper(&anonident->v, epoint);
+}
+
 static bool get_exp_compat(int *wd, int stop) {/* length in bytes, defined */
     char ch;
 
@@ -794,30 +905,31 @@ static bool get_val2(struct eval_context_s *ev) {
         case O_INDEX:
             {
                 unsigned int args = 0;
-                Funcargs *tmp = (Funcargs *)val_alloc(FUNCARGS_OBJ);
+                Funcargs tmp;
                 op = (op == O_FUNC) ? O_PARENT : O_BRACKET;
                 while (v1->val->obj != OPER_OBJ || ((Oper *)v1->val)->op != op) {
                     args++;
                     if (vsp <= args) goto syntaxe;
                     v1 = &values[vsp - 1 - args];
                 }
-                tmp->val = &values[vsp - args];
-                tmp->len = args; /* assumes no referencing */
+                tmp.v.obj = FUNCARGS_OBJ;
+                tmp.v.refcount = 0; /* lives only for this call */
+                tmp.val = &values[vsp - args];
+                tmp.len = args; /* assumes no referencing */
                 if (v1 == values) goto syntaxe;
                 v1--;
 
                 oper.op = op2;
                 oper.v1 = v1->val;
-                oper.v2 = (Obj *)tmp;
+                oper.v2 = &tmp.v;
                 oper.epoint = &v1->epoint;
-                oper.epoint2 = (args != 0) ? &tmp->val->epoint : &o_out->epoint;
+                oper.epoint2 = (args != 0) ? &tmp.val->epoint : &o_out->epoint;
                 oper.epoint3 = &o_out->epoint;
                 if (op == O_BRACKET) {
                     val = oper.v1->obj->slice(oper.v1, &oper, 0);
                 } else {
                     val = oper.v1->obj->calc2(&oper);
                 }
-                val_destroy(&tmp->v);
                 val_destroy(v1->val); v1->val = val;
 
                 vsp -= args + 1;
@@ -893,10 +1005,9 @@ static bool get_val2(struct eval_context_s *ev) {
                 }
                 dict = new_dict();
                 v1->val = (Obj *)dict;
-                dict->len = 0;
-                dict->def = NULL;
                 if (args != 0) {
                     unsigned int j;
+                    dict_reserve(dict, args);
                     vsp -= args;
                     for (j = 0; j < args; j++) {
                         Error *err;
@@ -908,30 +1019,15 @@ static bool get_val2(struct eval_context_s *ev) {
                         if (v2->val->obj == COLONLIST_OBJ) {
                             Colonlist *list = (Colonlist *)v2->val;
                             Obj *key = list->data[0];
-                            struct pair_s *p, *p2;
-                            struct avltree_node *b;
                             if (key->obj == DEFAULT_OBJ) {
                                 if (dict->def != NULL) val_destroy(dict->def);
                                 dict->def = val_reference(list->data[1]);
                             } else {
-                                p = (struct pair_s *)mallocx(sizeof *p);
-                                err = key->obj->hash(key, &p->hash, &v2->epoint);
+                                err = dict_insert(dict, key, list->data[1], &v2->epoint);
                                 if (err != NULL) {
-                                    free(p);
                                     val_destroy(v1->val); v1->val = &err->v;
                                     break;
                                 }
-                                p->key = key;
-                                b = avltree_insert(&p->node, &dict->members, pair_compare);
-                                if (b != NULL) {
-                                    p2 = avltree_container_of(b, struct pair_s, node);
-                                    val_replace(&p2->data, list->data[1]);
-                                    free(p);
-                                } else {
-                                    p->key = val_reference(p->key);
-                                    p->data = val_reference(list->data[1]);
-                                    dict->len++;
-                                }
                             }
                             continue;
                         }
@@ -1102,15 +1198,15 @@ static bool get_val2(struct eval_context_s *ev) {
             }
             if (v1->val->obj == DICT_OBJ) {
                 Dict *tmp = (Dict *)v1->val;
-                const struct avltree_node *n;
+                size_t n;
                 size_t len = (tmp->def == NULL) ? tmp->len : tmp->len + 1;
                 size_t len2 = vsp + len;
                 if (len < tmp->len || len2 < len) err_msg_out_of_memory(); /* overflow */
                 v1->val = NULL;
                 vsp--;
                 if (len2 >= ev->values_size) values = extend_values(ev, len);
-                for (n = avltree_first(&tmp->members); n != NULL; n = avltree_next(n)) {
-                    const struct pair_s *p = cavltree_container_of(n, struct pair_s, node);
+                for (n = 0; n < tmp->len; n++) {
+                    const struct pair_s *p = &tmp->data[n];
                     Colonlist *list = new_colonlist();
                     list->len = 2;
                     list->data = list_create_elements(list, 2);
@@ -1211,6 +1307,71 @@ size_t get_val_remaining(void) {
 }
 
 
+/* Store the output queue of a successfully parsed expression. Label
+   references are resolved again when it's replayed. */
+static void cache_exp(struct lcache_s *lcache, linecpos_t pos, int stop, int wd) {
+    size_t i, j;
+    struct lexpr_s *e;
+    struct lrpn_s *rpn;
+    if (eval->outp == 0) return;
+    for (i = 0, j = 0; i < eval->outp; i++) {
+        const struct values_s *o_out = &eval->o_out[i];
+        if (o_out->epoint.line != lpoint.line) return;
+        if (j < rpnfixes && rpnfix[j].outp == i) {
+            j++;
+            continue;
+        }
+        if (o_out->val->obj == ERROR_OBJ) return;
+    }
+    e = lcache_add_expr(lcache, eval->outp);
+    if (e == NULL) return;
+    e->pos = pos;
+    e->end = lpoint.pos;
+    e->stop = stop;
+    e->wd = wd;
+    rpn = e->rpn;
+    for (i = 0, j = 0; i < eval->outp; i++) {
+        const struct values_s *o_out = &eval->o_out[i];
+        rpn[i].pos = o_out->epoint.pos;
+        if (j < rpnfixes && rpnfix[j].outp == i) {
+            rpn[i].type = rpnfix[j].type;
+            rpn[i].arg = rpnfix[j].arg;
+            rpn[i].val = NULL;
+            rpn[i].atom = rpnfix[j].atom;
+            rpn[i].ident.label = NULL;
+            j++;
+            continue;
+        }
+        rpn[i].type = RPN_VALUE;
+        rpn[i].arg = 0;
+        rpn[i].atom = NULL;
+        rpn[i].val = (o_out->val->refcount != 0) ? val_reference(o_out->val) : o_out->val;
+    }
+}
+
+static bool get_exp_cached(const struct lexpr_s *e, int *wd) {
+    size_t i;
+    struct linepos_s epoint;
+
+    eval->outp = 0;
+    epoint.line = lpoint.line;
+    for (i = 0; i < e->len; i++) {
+        struct lrpn_s *rpn = &e->rpn[i];
+        epoint.pos = rpn->pos;
+        switch ((enum rpn_e)rpn->type) {
+        case RPN_VALUE: push_oper((rpn->val->refcount != 0) ? val_reference(rpn->val) : rpn->val, &epoint); break;
+        case RPN_LABEL: push_label(rpn->atom, &rpn->ident, (size_t)rpn->arg, &epoint); break;
+        case RPN_IDENT: push_ident(rpn->atom, &rpn->ident, (size_t)rpn->arg, &epoint); break;
+        case RPN_ANON: push_anon(rpn->arg, &epoint); break;
+        case RPN_ANONIDENT: push_anonident(rpn->arg, &epoint); break;
+        case RPN_STAR: push_oper(get_star(&epoint), &epoint); break;
+        }
+    }
+    *wd = e->wd;
+    lpoint.pos = e->end;
+    return get_val2(eval);
+}
+
 /* 0 - normal */
 /* 1 - 1 only, till comma */
 /* 2 - 1 only, till space  */
@@ -1229,6 +1390,13 @@ static bool get_exp2(int *wd, int stop, struct file_s *cfile) {
     struct linepos_s epoint;
     size_t llen;
     size_t openclose, identlist;
+    int32_t anon;
+    str_t ident;
+    const struct atom_s *atom;
+    struct lcache_s *lcache;
+    linecpos_t startpos;
+    size_t messages;
+    bool nocache;
 
     eval->gstop = stop;
     eval->outp2 = 0;
@@ -1238,6 +1406,16 @@ static bool get_exp2(int *wd, int stop, struct file_s *cfile) {
         if (get_exp_compat(wd, stop)) return get_val2_compat(eval);
         return false;
     }
+    lcache = get_lcache(cfile);
+    startpos = lpoint.pos;
+    if (lcache != NULL) {
+        const struct lexpr_s *e = lcache_expr(lcache, startpos, stop);
+        if (e != NULL) return get_exp_cached(e, wd);
+        messages = error_messages();
+    } else messages = 0;
+    rpnfixes = 0;
+    nocache = false;
+
     eval->outp = 0;
     o_oper[0].val = &o_COMMA;
 
@@ -1327,11 +1505,11 @@ static bool get_exp2(int *wd, int stop, struct file_s *cfile) {
         case '#': op = &o_HASH; break;
         case '`': op = &o_BANK; break;
         case '^': op = &o_STRING; break;
-        case '$': push_oper(get_hex(&epoint), &epoint);goto other;
-        case '%': if ((pline[lpoint.pos + 1] & 0xfe) == 0x30 || (pline[lpoint.pos + 1] == '.' && (pline[lpoint.pos + 2] & 0xfe) == 0x30)) { push_oper(get_bin(&epoint), &epoint);goto other; }
+        case '$': push_oper(get_literal(cfile, &epoint), &epoint);goto other;
+        case '%': if ((pline[lpoint.pos + 1] & 0xfe) == 0x30 || (pline[lpoint.pos + 1] == '.' && (pline[lpoint.pos + 2] & 0xfe) == 0x30)) { push_oper(get_literal(cfile, &epoint), &epoint);goto other; }
                   goto tryanon;
         case '"':
-        case '\'': push_oper(get_string(), &epoint);goto other;
+        case '\'': push_oper(get_literal(cfile, &epoint), &epoint);goto other;
         case '?': 
             if (operp != 0) {
                 const Oper *o = o_oper[operp - 1].val;
@@ -1340,7 +1518,7 @@ static bool get_exp2(int *wd, int stop, struct file_s *cfile) {
             lpoint.pos++;push_oper((Obj *)ref_gap(), &epoint);goto other;
         case '.': if ((pline[lpoint.pos + 1] ^ 0x30) >= 10) goto tryanon; /* fall through */;
         case '0': case '1': case '2': case '3': case '4': case '5': case '6': case '7': case '8': case '9':
-            push_oper(get_float(&epoint), &epoint);
+            push_oper(get_literal(cfile, &epoint), &epoint);
             goto other;
         case 0:
         case ';': 
@@ -1353,10 +1531,6 @@ static bool get_exp2(int *wd, int stop, struct file_s *cfile) {
             goto tryanon;
         default: 
             if (get_label() != 0) {
-                bool down;
-                Label *l;
-                Error *err;
-                str_t ident;
             as_ident:
                 if (pline[epoint.pos + 1] == '"' || pline[epoint.pos + 1] == '\'') {
                     enum bytes_mode_e mode;
@@ -1370,6 +1544,7 @@ static bool get_exp2(int *wd, int stop, struct file_s *cfile) {
                     }
                     if (mode != BYTES_MODE_NULL_CHECK) {
                         Obj *str = get_string();
+                        nocache = true; /* depends on the encoding */
                         epoint.pos++;
                         if (str->obj == STR_OBJ) {
                             push_oper(bytes_from_str((Str *)str, &epoint, mode), &epoint);
@@ -1378,81 +1553,34 @@ static bool get_exp2(int *wd, int stop, struct file_s *cfile) {
                         goto other;
                     }
                 }
-                if ((operp != 0 && o_oper[operp - 1].val == &o_MEMBER) || identlist != 0) {
-                    Ident *idn = (Ident *)val_alloc(IDENT_OBJ);
-                    idn->name.data = pline + epoint.pos;
-                    idn->name.len = lpoint.pos - epoint.pos;
-                    idn->epoint = epoint;
-                    push_oper(&idn->v, &epoint);
-                    goto other;
-                } 
                 ident.data = pline + epoint.pos;
                 ident.len = lpoint.pos - epoint.pos;
-                down = (ident.data[0] != '_');
-                l = down ? find_label(&ident, NULL) : find_label2(&ident, cheap_context);
-                if (l != NULL) {
-                    touch_label(l);
-                    if (down) l->shadowcheck = true;
-                    push_oper(val_reference(l->value), &epoint);
+                atom = intern_ident(&ident);
+                if ((operp != 0 && o_oper[operp - 1].val == &o_MEMBER) || identlist != 0) {
+                    push_ident(atom, NULL, ident.len, &epoint);
+                    push_rpnfix(RPN_IDENT, (int32_t)ident.len, atom);
                     goto other;
-                }
-                err = new_error(ERROR___NOT_DEFINED, &epoint);
-                err->u.notdef.ident = ident;
-                err->u.notdef.names = ref_namespace(down ? current_context : cheap_context);
-                err->u.notdef.down = down;
-                push_oper(&err->v, &epoint);
+                } 
+                push_label(atom, NULL, ident.len, &epoint);
+                push_rpnfix(RPN_LABEL, (int32_t)ident.len, atom);
                 goto other;
             }
         tryanon:
             db = operp;
             while (operp != 0 && o_oper[operp - 1].val == &o_POS) operp--;
-            if (db != operp) {
-                Label *l;
-                Error *err;
-                if ((operp != 0 && o_oper[operp - 1].val == &o_MEMBER) || identlist != 0) {
-                    Anonident *anonident = (Anonident *)val_alloc(ANONIDENT_OBJ);
-                    anonident->count = db - operp - 1;
-                    anonident->epoint = o_oper[operp].epoint;
-                    push_oper(&anonident->v, &o_oper[operp].epoint);
-                    goto other;
-                }
-                l = find_anonlabel(db - operp -1);
-                if (l != NULL) {
-                    touch_label(l);
-                    push_oper(val_reference(l->value), &o_oper[operp].epoint);
-                    goto other;
-                }
-                err = new_error(ERROR___NOT_DEFINED, &o_oper[operp].epoint);
-                err->u.notdef.ident.len = (size_t)((ssize_t)(db - operp));
-                err->u.notdef.ident.data = NULL;
-                err->u.notdef.names = ref_namespace(current_context);
-                err->u.notdef.down = true;
-                push_oper(&err->v, &o_oper[operp].epoint);
-                goto other;
+            if (db != operp) anon = db - operp;
+            else {
+                while (operp != 0 && o_oper[operp - 1].val == &o_NEG) operp--;
+                anon = operp - db;
             }
-            while (operp != 0 && o_oper[operp - 1].val == &o_NEG) operp--;
-            if (db != operp) {
-                Label *l;
-                Error *err;
+            if (anon != 0) {
                 if ((operp != 0 && o_oper[operp - 1].val == &o_MEMBER) || identlist != 0) {
-                    Anonident *anonident = (Anonident *)val_alloc(ANONIDENT_OBJ);
-                    anonident->count = operp - db;
-                    anonident->epoint = o_oper[operp].epoint;
-                    push_oper(&anonident->v, &o_oper[operp].epoint);
-                    goto other;
-                }
-                l = find_anonlabel(operp - db);
-                if (l != NULL) {
-                    touch_label(l);
-                    push_oper(val_reference(l->value), &o_oper[operp].epoint);
+                    push_anonident(anon, &o_oper[operp].epoint);
+                    push_rpnfix(RPN_ANONIDENT, anon, NULL);
                     goto other;
                 }
-                err = new_error(ERROR___NOT_DEFINED, &o_oper[operp].epoint);
-                err->u.notdef.ident.len = (size_t)((ssize_t)(operp - db));
-                err->u.notdef.ident.data = NULL;
-                err->u.notdef.names = ref_namespace(current_context);
-                err->u.notdef.down = true;
-                push_oper(&err->v, &o_oper[operp].epoint);
+                push_anon(anon, &o_oper[operp].epoint);
+                push_rpnfix(RPN_ANON, anon, NULL);
                 goto other;
             }
             if (operp != 0) {
@@ -1463,6 +1591,7 @@ static bool get_exp2(int *wd, int stop, struct file_s *cfile) {
                 if (o_oper[operp - 1].val == &o_SPLAT) {
                     operp--;
                     push_oper(get_star(&o_oper[operp].epoint), &o_oper[operp].epoint);
+                    push_rpnfix(RPN_STAR, 0, NULL);
                     goto other;
                 }
                 epoint = o_oper[operp - 1].epoint;
@@ -1473,6 +1602,7 @@ static bool get_exp2(int *wd, int stop, struct file_s *cfile) {
             operp--;
             lpoint.pos = epoint.pos;
             push_oper(get_star(&o_oper[operp].epoint), &o_oper[operp].epoint);
+            push_rpnfix(RPN_STAR, 0, NULL);
             goto other;
         }
         lpoint.pos++;
@@ -1675,7 +1805,10 @@ static bool get_exp2(int *wd, int stop, struct file_s *cfile) {
             operp--;
             push_oper((Obj *)o_oper[operp].val, &o_oper[operp].epoint);
         }
-        if (operp == 0) return get_val2(eval);
+        if (operp == 0) {
+            if (lcache != NULL && !nocache && messages == error_messages()) cache_exp(lcache, startpos, stop, *wd);
+            return get_val2(eval);
+        }
     syntaxe:
         err_msg2(ERROR_EXPRES_SYNTAX, NULL, &epoint);
     error:
@@ -1685,7 +1818,14 @@ static bool get_exp2(int *wd, int stop, struct file_s *cfile) {
 }
 
 bool get_exp(int *wd, int stop, struct file_s *cfile, unsigned int min, unsigned int max, linepos_t epoint) {/* length in bytes, defined */
-    if (!get_exp2(wd, stop, cfile)) {
+    bool ret;
+    struct profile_line_s *pl = profile_line_current();
+    if (pl != NULL) {
+        proftime_t start = profile_time();
+        ret = get_exp2(wd, stop, cfile);
+        profile_expr(pl, start);
+    } else ret = get_exp2(wd, stop, cfile);
+    if (!ret) {
         return false;
     }
     if (eval->values_len < min || (max != 0 && eval->values_len > max)) {
@@ -1830,4 +1970,5 @@ void destroy_eval(void) {
         free(eval);
     }
     free(evx);
+    free(rpnfix);
 }
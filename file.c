@@ -20,14 +20,32 @@
 #include <string.h>
 #include "wchar.h"
 #include <errno.h>
+#ifndef _MSC_VER
+#include <unistd.h>
+#endif
 #ifdef _WIN32
 #include <locale.h>
+#elif _POSIX_MAPPED_FILES > 0
+#include <sys/mman.h>
+#include <sys/stat.h>
+#define MAPPED_FILES
+#endif
+#if !defined _WIN32 && _POSIX_ADVISORY_INFO > 0
+#include <fcntl.h>
+#include <sys/stat.h>
+#define PREFETCH_FILES
+#endif
+#if !defined _WIN32 && _POSIX_VERSION > 0
+#include <sys/stat.h>
+#include <time.h>
+#define CACHE_STAMPS
 #endif
 #include "64tass.h"
 #include "unicode.h"
 #include "error.h"
 #include "strobj.h"
 #include "arguments.h"
+#include "values.h"
 
 #define REPLACEMENT_CHARACTER 0xfffd
 
@@ -66,6 +84,14 @@ void include_list_add(const char *path)
     if (i != j) memcpy(include_list_last->path + i, "/", 2);
 }
 
+uint32_t include_list_hash(uint32_t h) {
+    const struct include_list_s *i;
+    for (i = include_list.next; i != NULL; i = i->next) {
+        h = file_hash(h, (const uint8_t *)i->path, strlen(i->path) + 1);
+    }
+    return h;
+}
+
 char *get_path(const Str *v, const char *base) {
     char *path;
     size_t i, len;
@@ -189,11 +215,36 @@ static void star_free(struct avltree_node *aa)
     avltree_destroy(&a->tree, star_free);
 }
 
+static void lcache_free(struct file_s *a) {
+    line_t i;
+    if (a->lcache == NULL) return;
+    for (i = 0; i < a->lines; i++) {
+        struct lcache_s *l = &a->lcache[i];
+        while (l->tokens != 0) val_destroy(l->token[--l->tokens].val);
+        free(l->token);
+        for (; l->expr != NULL; l->expr = l->expr->next) {
+            struct lexpr_s *e = l->expr;
+            while (e->len != 0) {
+                Obj *v = e->rpn[--e->len].val;
+                if (v != NULL) val_destroy(v);
+            }
+        }
+    }
+    free(a->lcache);
+}
+
 static void file_free(struct avltree_node *aa)
 {
     struct file_s *a = avltree_container_of(aa, struct file_s, node);
 
     avltree_destroy(&a->star, star_free);
+    lcache_free(a);
+#ifdef MAPPED_FILES
+    if (a->mapped) {
+        munmap(a->data, a->len);
+        close(a->mapfd);
+    } else
+#endif
     free(a->data);
     free(a->line);
     free((char *)a->name);
@@ -244,6 +295,637 @@ static inline uint32_t fromiso(uint8_t c) {
     return conv[c - 0x80];
 }
 
+/* FNV-1a hash of the raw file content, used for validating the label cache */
+uint32_t file_hash(uint32_t h, const uint8_t *data, size_t len) {
+    while (len != 0) {
+        h = (h ^ *data++) * 16777619;
+        len--;
+    }
+    return h;
+}
+
+#ifdef MAPPED_FILES
+#define MAP_MIN_SIZE 0x100000
+
+/* Binary files are used as they are, so big regular ones are mapped
+   instead of being copied into memory. Only the pages used get read, the
+   hash is calculated when needed. Small ones are still copied, those
+   can't fault if the file is truncated meanwhile. */
+static bool file_map(struct file_s *tmp, FILE *f) {
+    struct stat st;
+    void *p;
+    int fd = fileno(f);
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size < MAP_MIN_SIZE) return false;
+    if ((uintmax_t)st.st_size > SIZE_MAX || ftell(f) != 0) return false;
+    fd = dup(fd);
+    if (fd < 0) return false;
+    p = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (p == MAP_FAILED) {
+        close(fd);
+        return false;
+    }
+    tmp->data = (uint8_t *)p;
+    tmp->len = (size_t)st.st_size;
+    tmp->mapped = true;
+    tmp->mapfd = fd;
+    tmp->coding = E_UNKNOWN;
+    return true;
+}
+
+/* Reading beyond the end of a file truncated since it was mapped would
+   fault, so its size is checked before use */
+static bool file_map_valid(const struct file_s *tmp) {
+    struct stat st;
+    if (fstat(tmp->mapfd, &st) != 0) return false;
+    if ((uintmax_t)st.st_size >= tmp->len) return true;
+    errno = EIO;
+    return false;
+}
+#endif
+
+/* Characters which are copied as they are in every encoding except UTF-16 */
+static inline bool plain_ascii(uint8_t c) {
+    return c != 0 && c < 0x80 && c != 10 && c != 13;
+}
+
+/* End of a run of plain characters, checked a word at a time */
+static size_t plain_ascii_run(const uint8_t *data, size_t i, size_t end) {
+    const size_t ones = ~(size_t)0 / 255, highs = ones << 7;
+    while (i + sizeof ones <= end) {
+        size_t w, lf, cr;
+        memcpy(&w, data + i, sizeof w);
+        lf = w ^ (ones * 10);
+        cr = w ^ (ones * 13);
+        if ((((w - ones) & ~w) | ((lf - ones) & ~lf) | ((cr - ones) & ~cr) | w) & highs) break;
+        i += sizeof w;
+    }
+    while (i < end && plain_ascii(data[i])) i++;
+    return i;
+}
+
+static bool file_read(struct file_s *tmp, FILE *f, int ftype) {
+    enum filecoding_e type = E_UNKNOWN;
+    uint32_t c = 0;
+    size_t fp = 0;
+    if (ftype == 1) {
+#ifdef MAPPED_FILES
+        if (file_map(tmp, f)) return false;
+#endif
+        if (fseek(f, 0, SEEK_END) == 0) {
+            long len = ftell(f);
+            if (len >= 0) {
+                tmp->data = (uint8_t *)mallocx(len);
+                tmp->len = len;
+            }
+            rewind(f);
+        }
+        do {
+            if (fp + 4096 > tmp->len) {
+                tmp->len += 4096;
+                if (tmp->len < 4096) err_msg_out_of_memory(); /* overflow */
+                tmp->data = (uint8_t *)reallocx(tmp->data, tmp->len);
+            }
+            fp += fread(tmp->data + fp, 1, tmp->len - fp, f);
+        } while (feof(f) == 0);
+        tmp->hash = file_hash(tmp->hash, tmp->data, fp);
+    } else {
+        struct ubuff_s ubuff = {NULL, 0, 0};
+        size_t max_lines = 0;
+        line_t lines = 0;
+        uint8_t buffer[BUFSIZ * 2];
+        size_t bp = 0, bl, qr = 1;
+        if (fseek(f, 0, SEEK_END) == 0) {
+            long len = ftell(f);
+            if (len >= 0) {
+                len += 4096;
+                if (len < 4096) err_msg_out_of_memory(); /* overflow */
+                tmp->data = (uint8_t *)mallocx(len);
+                tmp->len = len;
+                max_lines = (len / 20 + 1024) & ~1023;
+                if (max_lines > SIZE_MAX / sizeof *tmp->line) err_msg_out_of_memory(); /* overflow */
+                tmp->line = (size_t *)mallocx(max_lines * sizeof *tmp->line);
+            }
+            rewind(f);
+        }
+        bl = fread(buffer, 1, BUFSIZ, f);
+        tmp->hash = file_hash(tmp->hash, buffer, bl);
+        if (bl != 0 && buffer[0] == 0) type = E_UTF16BE; /* most likely */
+#ifdef _WIN32
+        setlocale(LC_CTYPE, "");
+#endif
+        do {
+            int i, j;
+            uint8_t *p;
+            uint32_t lastchar;
+            bool qc = true;
+            uint8_t cclass = 0;
+
+            if (lines >= max_lines) {
+                max_lines += 1024;
+                if (/*max_lines < 1024 ||*/ max_lines > SIZE_MAX / sizeof *tmp->line) err_msg_out_of_memory(); /* overflow */
+                tmp->line = (size_t *)reallocx(tmp->line, max_lines * sizeof *tmp->line);
+            }
+            tmp->line[lines++] = fp;
+            if (lines < 1) err_msg_out_of_memory(); /* overflow */
+            ubuff.p = 0;
+            p = tmp->data + fp;
+            for (;;) {
+                size_t o = p - tmp->data;
+                uint8_t ch2;
+                if (o + 6*6 + 1 > tmp->len) {
+                    tmp->len += 4096;
+                    if (tmp->len < 4096) err_msg_out_of_memory(); /* overflow */
+                    tmp->data = (uint8_t *)reallocx(tmp->data, tmp->len);
+                    p = tmp->data + o;
+                }
+                if (bp / (BUFSIZ / 2) == qr) {
+                    if (qr == 1) {
+                        qr = 3;
+                        if (feof(f) == 0) {
+                            bl = fread(buffer + BUFSIZ, 1, BUFSIZ, f);
+                            tmp->hash = file_hash(tmp->hash, buffer + BUFSIZ, bl);
+                            bl += BUFSIZ;
+                        }
+                    } else {
+                        qr = 1;
+                        if (feof(f) == 0) {
+                            bl = fread(buffer, 1, BUFSIZ, f);
+                            tmp->hash = file_hash(tmp->hash, buffer, bl);
+                        }
+                    }
+                }
+                if (bp == bl) break;
+                if (plain_ascii(buffer[bp]) && (!arguments.toascii || (qc && ubuff.p == 1 && type != E_UTF16LE && type != E_UTF16BE))) {
+                    /* Run of plain ASCII characters, up to the line end,
+                       the end of data or the next buffer refill */
+                    size_t e, end = qr * (BUFSIZ / 2);
+                    if (bp > end) end = BUFSIZ * 2;
+                    if (bl > bp && bl < end) end = bl;
+                    e = plain_ascii_run(buffer, bp + 1, end);
+                    if (o + (e - bp) + 6*6 + 1 > tmp->len) {
+                        tmp->len = o + (e - bp) + 4096;
+                        if (tmp->len < 4096) err_msg_out_of_memory(); /* overflow */
+                        tmp->data = (uint8_t *)reallocx(tmp->data, tmp->len);
+                        p = tmp->data + o;
+                    }
+                    if (arguments.toascii) {
+                        uint32_t ch = ubuff.data[0];
+                        if (ch != 0 && ch < 0x80) *p++ = ch; else p = utf8out(ch, p);
+                        e--;
+                        ubuff.data[0] = buffer[e];
+                        cclass = 0;
+                    }
+                    memcpy(p, buffer + bp, e - bp);
+                    p += e - bp;
+                    c = buffer[arguments.toascii ? e : e - 1];
+                    bp = (arguments.toascii ? e + 1 : e) % (BUFSIZ * 2);
+                    continue;
+                }
+                lastchar = c;
+                c = buffer[bp]; bp = (bp + 1) % (BUFSIZ * 2);
+                if (!arguments.toascii) {
+                    if (c == 10) {
+                        if (lastchar == 13) continue;
+                        break;
+                    } else if (c == 13) {
+                        break;
+                    }
+                    if (c != 0 && c < 0x80) *p++ = c; else p = utf8out(c, p);
+                    continue;
+                }
+                switch (type) {
+                case E_UNKNOWN:
+                case E_UTF8:
+                    if (c < 0x80) goto done;
+                    if (c < 0xc0) {
+                    invalid:
+                        if (type == E_UNKNOWN) {
+                            c = fromiso(c);
+                            type = E_ISO; break;
+                        }
+                        c = REPLACEMENT_CHARACTER; break;
+                    } 
+                    ch2 = (bp == bl) ? 0 : buffer[bp];
+                    if (c < 0xe0) {
+                        if (c < 0xc2) goto invalid;
+                        c ^= 0xc0; i = 1;
+                    } else if (c < 0xf0) {
+                        if ((c ^ 0xe0) == 0 && (ch2 ^ 0xa0) >= 0x20) goto invalid;
+                        c ^= 0xe0; i = 2;
+                    } else if (c < 0xf8) {
+                        if ((c ^ 0xf0) == 0 && (uint8_t)(ch2 - 0x90) >= 0x30) goto invalid;
+                        c ^= 0xf0; i = 3;
+                    } else if (c < 0xfc) {
+                        if ((c ^ 0xf8) == 0 && (uint8_t)(ch2 - 0x88) >= 0x38) goto invalid;
+                        c ^= 0xf8; i = 4;
+                    } else if (c < 0xfe) {
+                        if ((c ^ 0xfc) == 0 && (uint8_t)(ch2 - 0x84) >= 0x3c) goto invalid;
+                        c ^= 0xfc; i = 5;
+                    } else {
+                        if (type != E_UNKNOWN) goto invalid;
+                        if (c == 0xff && ch2 == 0xfe) type = E_UTF16LE;
+                        else if (c == 0xfe && ch2 == 0xff) type = E_UTF16BE;
+                        else goto invalid;
+                        bp = (bp + 1) % (BUFSIZ * 2);
+                        continue;
+                    }
+
+                    for (j = i; i != 0; i--) {
+                        if (bp != bl) {
+                            ch2 = buffer[bp];
+                            if ((ch2 ^ 0x80) < 0x40) {
+                                c = (c << 6) ^ ch2 ^ 0x80;
+                                bp = (bp + 1) % (BUFSIZ * 2);
+                                continue;
+                            }
+                        }
+                        if (type != E_UNKNOWN) {
+                            c = REPLACEMENT_CHARACTER;break;
+                        }
+                        type = E_ISO;
+                        i = (j - i) * 6;
+                        qc = false;
+                        if (ubuff.p >= ubuff.len) {
+                            ubuff.len += 16;
+                            if (/*ubuff.len < 16 ||*/ ubuff.len > SIZE_MAX / sizeof *ubuff.data) err_msg_out_of_memory(); /* overflow */
+                            ubuff.data = (uint32_t *)reallocx(ubuff.data, ubuff.len * sizeof *ubuff.data);
+                        }
+                        ubuff.data[ubuff.p++] = fromiso(((~0x7f >> j) & 0xff) | (c >> i));
+                        for (;i != 0; i-= 6) {
+                            if (ubuff.p >= ubuff.len) {
+                                ubuff.len += 16;
+                                if (/*ubuff.len < 16 ||*/ ubuff.len > SIZE_MAX / sizeof *ubuff.data) err_msg_out_of_memory(); /* overflow */
+                                ubuff.data = (uint32_t *)reallocx(ubuff.data, ubuff.len * sizeof *ubuff.data);
+                            }
+                            ubuff.data[ubuff.p++] = fromiso(((c >> (i-6)) & 0x3f) | 0x80);
+                        }
+                        if (bp == bl) goto eof;
+                        c = (ch2 >= 0x80) ? fromiso(ch2) : ch2; 
+                        j = 0;
+                        bp = (bp + 1) % (BUFSIZ * 2);
+                        break;
+                    }
+                    if (j != 0) type = E_UTF8;
+                    break;
+                case E_UTF16LE:
+                    if (bp == bl) goto invalid;
+                    c |= buffer[bp] << 8; bp = (bp + 1) % (BUFSIZ * 2);
+                    if (c == 0xfffe) {
+                        type = E_UTF16BE;
+                        continue;
+                    }
+                    break;
+                case E_UTF16BE:
+                    if (bp == bl) goto invalid;
+                    c = (c << 8) | buffer[bp]; bp = (bp + 1) % (BUFSIZ * 2);
+                    if (c == 0xfffe) {
+                        type = E_UTF16LE;
+                        continue;
+                    }
+                    break;
+                case E_ISO:
+                    if (c >= 0x80) c = fromiso(c);
+                    goto done;
+                }
+                if (c == 0xfeff) continue;
+                if (type != E_UTF8) {
+                    if (c >= 0xd800 && c < 0xdc00) {
+                        if (lastchar < 0xd800 || lastchar >= 0xdc00) continue;
+                        c = REPLACEMENT_CHARACTER;
+                    } else if (c >= 0xdc00 && c < 0xe000) {
+                        if (lastchar >= 0xd800 && lastchar < 0xdc00) {
+                            c ^= 0x360dc00 ^ (lastchar << 10);
+                            c += 0x10000;
+                        } else
+                            c = REPLACEMENT_CHARACTER;
+                    } else if (lastchar >= 0xd800 && lastchar < 0xdc00) {
+                        c = REPLACEMENT_CHARACTER;
+                    }
+                }
+            done:
+                if (c < 0xc0) {
+                    if (c == 10) {
+                        if (lastchar == 13) continue;
+                        break;
+                    } else if (c == 13) {
+                        break;
+                    }
+                    cclass = 0;
+                    if (!qc) {
+                        unfc(&ubuff);
+                        qc = true;
+                    }
+                    if (ubuff.p == 1) {
+                        if (ubuff.data[0] != 0 && ubuff.data[0] < 0x80) *p++ = ubuff.data[0]; else p = utf8out(ubuff.data[0], p);
+                    } else {
+                        p = flushubuff(&ubuff, p, tmp);
+                        ubuff.p = 1;
+                    }
+                    ubuff.data[0] = c;
+                } else {
+                    const struct properties_s *prop = uget_property(c);
+                    uint8_t ncclass = prop->combclass;
+                    if ((ncclass != 0 && cclass > ncclass) || (prop->property & (qc_N | qc_M)) != 0) {
+                        qc = false;
+                        if (ubuff.p >= ubuff.len) {
+                            ubuff.len += 16;
+                            if (/*ubuff.len < 16 ||*/ ubuff.len > SIZE_MAX / sizeof *ubuff.data) err_msg_out_of_memory(); /* overflow */
+                            ubuff.data = (uint32_t *)reallocx(ubuff.data, ubuff.len * sizeof *ubuff.data);
+                        }
+                        ubuff.data[ubuff.p++] = c;
+                    } else {
+                        if (!qc) {
+                            unfc(&ubuff);
+                            qc = true; 
+                        }
+                        if (ubuff.p == 1) {
+                            if (ubuff.data[0] != 0 && ubuff.data[0] < 0x80) *p++ = ubuff.data[0]; else p = utf8out(ubuff.data[0], p);
+                        } else {
+                            p = flushubuff(&ubuff, p, tmp);
+                            ubuff.p = 1;
+                        }
+                        ubuff.data[0] = c;
+                    }
+                    cclass = ncclass;
+                }
+            }
+        eof:
+            if (!qc) unfc(&ubuff);
+            p = flushubuff(&ubuff, p, tmp);
+            i = (p - tmp->data) - fp;
+            p = tmp->data + fp;
+            while (i != 0 && (p[i-1]==' ' || p[i-1]=='\t')) i--;
+            p[i++] = 0;
+            fp += i;
+        } while (bp != bl);
+#ifdef _WIN32
+        setlocale(LC_CTYPE, "C");
+#endif
+        free(ubuff.data);
+        tmp->lines = lines;
+        if (lines != max_lines) {
+            tmp->line = (size_t *)reallocx(tmp->line, lines * sizeof *tmp->line);
+        }
+    }
+    tmp->len = fp;
+    tmp->data = (uint8_t *)reallocx(tmp->data, tmp->len);
+    tmp->coding = type;
+    return ferror(f) != 0;
+}
+
+struct file_cache_s {      /* decoded source kept between server requests */
+    const char *realname;
+    bool toascii;
+    uint32_t hash;
+#ifdef CACHE_STAMPS
+    bool stamped;          /* size and time can be trusted */
+    off_t size;
+    time_t mtime;
+#endif
+    uint8_t *data;
+    size_t len;
+    size_t *line;
+    line_t lines;
+    enum filecoding_e coding;
+    struct avltree_node node;
+};
+
+static struct avltree file_cache;
+static FILE *file_reporter = NULL;
+
+static int file_cache_compare(const struct avltree_node *aa, const struct avltree_node *bb)
+{
+    const struct file_cache_s *a = cavltree_container_of(aa, struct file_cache_s, node);
+    const struct file_cache_s *b = cavltree_container_of(bb, struct file_cache_s, node);
+    int c = strcmp(a->realname, b->realname);
+    if (c != 0) return c;
+    return a->toascii - b->toascii;
+}
+
+static void file_cache_free(struct avltree_node *aa)
+{
+    struct file_cache_s *a = avltree_container_of(aa, struct file_cache_s, node);
+
+    free(a->data);
+    free(a->line);
+    free((char *)a->realname);
+    free(a);
+}
+
+#ifdef CACHE_STAMPS
+/* Files modified in the second they were read might change again
+   unnoticed, those are always hashed */
+static void file_cache_stamp(struct file_cache_s *c, FILE *f) {
+    struct stat st;
+    c->stamped = fstat(fileno(f), &st) == 0 && S_ISREG(st.st_mode) && st.st_mtime < time(NULL);
+    c->size = c->stamped ? st.st_size : 0;
+    c->mtime = c->stamped ? st.st_mtime : 0;
+}
+
+static bool file_cache_unchanged(const struct file_cache_s *c, FILE *f) {
+    struct stat st;
+    if (!c->stamped || fstat(fileno(f), &st) != 0 || !S_ISREG(st.st_mode)) return false;
+    return st.st_size == c->size && st.st_mtime == c->mtime;
+}
+#endif
+
+/* Use the cached decoding if the raw content did not change. Files with
+   the same size and modification time are not read at all. */
+static bool file_cache_get(struct file_s *tmp, FILE *f) {
+    struct file_cache_s key, *c;
+    struct avltree_node *b;
+    uint8_t buffer[BUFSIZ];
+    uint32_t h = FILE_HASH_INIT;
+    size_t l;
+
+    if (file_cache.root == NULL) return false;
+    memset(&key, 0, sizeof key);
+    key.realname = tmp->realname;
+    key.toascii = arguments.toascii;
+    b = avltree_lookup(&key.node, &file_cache, file_cache_compare);
+    if (b == NULL) return false;
+    c = avltree_container_of(b, struct file_cache_s, node);
+#ifdef CACHE_STAMPS
+    if (file_cache_unchanged(c, f)) h = c->hash;
+    else
+#endif
+    {
+        do {
+            l = fread(buffer, 1, sizeof buffer, f);
+            h = file_hash(h, buffer, l);
+        } while (l == sizeof buffer);
+        if (ferror(f) != 0 || h != c->hash) {
+            rewind(f);
+            return false;
+        }
+    }
+    if (c->len != 0) {
+        tmp->data = (uint8_t *)mallocx(c->len);
+        memcpy(tmp->data, c->data, c->len);
+    }
+    tmp->len = c->len;
+    if (c->lines != 0) {
+        tmp->line = (size_t *)mallocx(c->lines * sizeof *tmp->line);
+        memcpy(tmp->line, c->line, c->lines * sizeof *tmp->line);
+    }
+    tmp->lines = c->lines;
+    tmp->coding = c->coding;
+    tmp->hash = h;
+    return true;
+}
+
+void file_cache_init(void) {
+    avltree_init(&file_cache);
+}
+
+void file_cache_add(const char *realname, bool toascii, uint32_t hash) {
+    struct file_cache_s *c = (struct file_cache_s *)mallocx(sizeof *c);
+    struct avltree_node *b;
+    struct file_s tmp;
+    bool oldtoascii = arguments.toascii;
+    int err;
+    FILE *f;
+
+    memset(c, 0, sizeof *c);
+    c->realname = realname;
+    c->toascii = toascii;
+    b = avltree_lookup(&c->node, &file_cache, file_cache_compare);
+    if (b != NULL && avltree_container_of(b, struct file_cache_s, node)->hash == hash) {
+        free(c);
+        return;
+    }
+    f = file_open(realname, "rb");
+    if (f == NULL) {
+        free(c);
+        return;
+    }
+#ifdef CACHE_STAMPS
+    file_cache_stamp(c, f); /* before reading, so later changes are seen */
+#endif
+    tmp.line = NULL;
+    tmp.lines = 0;
+    tmp.data = NULL;
+    tmp.len = 0;
+    tmp.hash = FILE_HASH_INIT;
+    arguments.toascii = toascii;
+    err = file_read(&tmp, f, 0) ? 1 : 0;
+    arguments.toascii = oldtoascii;
+    err |= fclose(f);
+    if (err != 0) {
+        free(tmp.data);
+        free(tmp.line);
+        free(c);
+        return;
+    }
+    if (b != NULL) {
+        struct file_cache_s *old = avltree_container_of(b, struct file_cache_s, node);
+#ifdef CACHE_STAMPS
+        old->stamped = c->stamped;
+        old->size = c->size;
+        old->mtime = c->mtime;
+#endif
+        free(c);
+        c = old;
+        free(c->data);
+        free(c->line);
+    } else {
+        size_t len = strlen(realname) + 1;
+        char *s = (char *)mallocx(len);
+        memcpy(s, realname, len);
+        c->realname = s;
+        avltree_insert(&c->node, &file_cache, file_cache_compare);
+    }
+    c->hash = tmp.hash;
+    c->data = tmp.data;
+    c->len = tmp.len;
+    c->line = tmp.line;
+    c->lines = tmp.lines;
+    c->coding = tmp.coding;
+}
+
+void file_cache_destroy(void) {
+    avltree_destroy(&file_cache, file_cache_free);
+}
+
+/* Sources used are listed here at exit for the server's cache */
+void file_report(FILE *f) {
+    file_reporter = f;
+}
+
+#ifdef PREFETCH_FILES
+static bool prefetch_path(const char *base, size_t baselen, const uint8_t *name, size_t len) {
+    char *path = (char *)mallocx(baselen + len + 1);
+    struct stat st;
+    int fd;
+    memcpy(path, base, baselen);
+    memcpy(path + baselen, name, len);
+    path[baselen + len] = 0;
+    /* Only regular files are opened, devices and fifos could be named in
+       branches which are not assembled. Non-blocking in case the file is
+       replaced in the meantime. */
+    if (stat(path, &st) != 0 || !S_ISREG(st.st_mode)) {
+        free(path);
+        return false;
+    }
+    fd = open(path, O_RDONLY | O_NONBLOCK);
+    free(path);
+    if (fd < 0) return false;
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode)) posix_fadvise(fd, 0, 0, POSIX_FADV_WILLNEED);
+    close(fd);
+    return true;
+}
+
+static bool prefetch_directive(const uint8_t *s, size_t len) {
+    static const char *const names[3] = {"include", "binclude", "binary"};
+    size_t i, j;
+    for (i = 0; i < lenof(names); i++) {
+        for (j = 0; j < len; j++) {
+            if ((s[j] | 0x20) != (uint8_t)names[i][j]) break;
+        }
+        if (j == len && names[i][j] == 0) return true;
+    }
+    return false;
+}
+
+/* Ask the system to start reading the files included with a literal
+   name, so they are likely in the cache by the time they're needed */
+static void file_prefetch(const struct file_s *tmp) {
+    char *base;
+    size_t baselen;
+    line_t i;
+    if (tmp->lines == 0) return;
+    base = get_path(NULL, tmp->realname);
+    baselen = strlen(base);
+    for (i = 0; i < tmp->lines; i++) {
+        const uint8_t *s = tmp->data + tmp->line[i], *name;
+        size_t len;
+        uint8_t q;
+        while (*s != 0 && *s != '.' && *s != ';' && *s != '"' && *s != '\'') s++;
+        if (*s++ != '.') continue;
+        for (len = 0; (s[len] | 0x20) >= 'a' && (s[len] | 0x20) <= 'z'; len++);
+        if (!prefetch_directive(s, len)) continue;
+        s += len;
+        if (*s != ' ' && *s != '\t') continue;
+        while (*s == ' ' || *s == '\t') s++;
+        q = *s++;
+        if (q != '"' && q != '\'') continue;
+        name = s;
+        while (*s != 0 && *s != q) s++;
+        if (*s != q || s[1] == q || s == name) continue;
+        len = s - name;
+        if (name[0] == '/') {
+            prefetch_path("", 0, name, len);
+        } else if (!prefetch_path(base, baselen, name, len)) {
+            const struct include_list_s *j;
+            for (j = include_list.next; j != NULL; j = j->next) {
+                if (prefetch_path(j->path, strlen(j->path), name, len)) break;
+            }
+        }
+    }
+    free(base);
+}
+#endif
+
 static struct file_s *command_line = NULL;
 static struct file_s *lastfi = NULL;
 static uint16_t curfnum = 1;
@@ -265,15 +947,15 @@ struct file_s *openfile(const char* name, const char *base, int ftype, const Str
         if (command_line == NULL) command_line = lastfi;
     }
     if (b == NULL) { /* new file */
-	enum filecoding_e type = E_UNKNOWN;
         FILE *f;
-        uint32_t c = 0;
-        size_t fp = 0;
 
 	lastfi->line = NULL;
 	lastfi->lines = 0;
+        lastfi->lcache = NULL;
 	lastfi->data = NULL;
 	lastfi->len = 0;
+        lastfi->mapped = false;
+        lastfi->hash = FILE_HASH_INIT;
         lastfi->open = 0;
         lastfi->type = ftype;
         avltree_init(&lastfi->star);
@@ -309,284 +991,21 @@ struct file_s *openfile(const char* name, const char *base, int ftype, const Str
                 free(path);
                 return NULL;
             }
-            if (ftype == 1) {
-                if (arguments.quiet) {
-                    printf("Reading file:      ");
-                    argv_print(tmp->realname, stdout);
-                    putchar('\n');
-                }
-                if (fseek(f, 0, SEEK_END) == 0) {
-                    long len = ftell(f);
-                    if (len >= 0) {
-                        tmp->data = (uint8_t *)mallocx(len);
-                        tmp->len = len;
-                    }
-                    rewind(f);
-                }
-                do {
-                    if (fp + 4096 > tmp->len) {
-                        tmp->len += 4096;
-                        if (tmp->len < 4096) err_msg_out_of_memory(); /* overflow */
-                        tmp->data = (uint8_t *)reallocx(tmp->data, tmp->len);
-                    }
-                    fp += fread(tmp->data + fp, 1, tmp->len - fp, f);
-                } while (feof(f) == 0);
+            if (arguments.quiet) {
+                printf((ftype == 1) ? "Reading file:      " : "Assembling file:   ");
+                argv_print(tmp->realname, stdout);
+                putchar('\n');
+            }
+            if (ftype != 1 && f != stdin && file_cache_get(tmp, f)) {
+                err = ferror(f);
             } else {
-                struct ubuff_s ubuff = {NULL, 0, 0};
-                size_t max_lines = 0;
-                line_t lines = 0;
-                uint8_t buffer[BUFSIZ * 2];
-                size_t bp = 0, bl, qr = 1;
-                if (arguments.quiet) {
-                    printf("Assembling file:   ");
-                    argv_print(tmp->realname, stdout);
-                    putchar('\n');
-                }
-                if (fseek(f, 0, SEEK_END) == 0) {
-                    long len = ftell(f);
-                    if (len >= 0) {
-                        len += 4096;
-                        if (len < 4096) err_msg_out_of_memory(); /* overflow */
-                        tmp->data = (uint8_t *)mallocx(len);
-                        tmp->len = len;
-                        max_lines = (len / 20 + 1024) & ~1023;
-                        if (max_lines > SIZE_MAX / sizeof *tmp->line) err_msg_out_of_memory(); /* overflow */
-                        tmp->line = (size_t *)mallocx(max_lines * sizeof *tmp->line);
-                    }
-                    rewind(f);
-                }
-                bl = fread(buffer, 1, BUFSIZ, f);
-                if (bl != 0 && buffer[0] == 0) type = E_UTF16BE; /* most likely */
-#ifdef _WIN32
-                setlocale(LC_CTYPE, "");
-#endif
-                do {
-                    int i, j;
-                    uint8_t *p;
-                    uint32_t lastchar;
-                    bool qc = true;
-                    uint8_t cclass = 0;
-
-                    if (lines >= max_lines) {
-                        max_lines += 1024;
-                        if (/*max_lines < 1024 ||*/ max_lines > SIZE_MAX / sizeof *tmp->line) err_msg_out_of_memory(); /* overflow */
-                        tmp->line = (size_t *)reallocx(tmp->line, max_lines * sizeof *tmp->line);
-                    }
-                    tmp->line[lines++] = fp;
-                    if (lines < 1) err_msg_out_of_memory(); /* overflow */
-                    ubuff.p = 0;
-                    p = tmp->data + fp;
-                    for (;;) {
-                        size_t o = p - tmp->data;
-                        uint8_t ch2;
-                        if (o + 6*6 + 1 > tmp->len) {
-                            tmp->len += 4096;
-                            if (tmp->len < 4096) err_msg_out_of_memory(); /* overflow */
-                            tmp->data = (uint8_t *)reallocx(tmp->data, tmp->len);
-                            p = tmp->data + o;
-                        }
-                        if (bp / (BUFSIZ / 2) == qr) {
-                            if (qr == 1) {
-                                qr = 3;
-                                if (feof(f) == 0) bl = BUFSIZ + fread(buffer + BUFSIZ, 1, BUFSIZ, f);
-                            } else {
-                                qr = 1;
-                                if (feof(f) == 0) bl = fread(buffer, 1, BUFSIZ, f);
-                            }
-                        }
-                        if (bp == bl) break;
-                        lastchar = c;
-                        c = buffer[bp]; bp = (bp + 1) % (BUFSIZ * 2);
-                        if (!arguments.toascii) {
-                            if (c == 10) {
-                                if (lastchar == 13) continue;
-                                break;
-                            } else if (c == 13) {
-                                break;
-                            }
-                            if (c != 0 && c < 0x80) *p++ = c; else p = utf8out(c, p);
-                            continue;
-                        }
-                        switch (type) {
-                        case E_UNKNOWN:
-                        case E_UTF8:
-                            if (c < 0x80) goto done;
-                            if (c < 0xc0) {
-                            invalid:
-                                if (type == E_UNKNOWN) {
-                                    c = fromiso(c);
-                                    type = E_ISO; break;
-                                }
-                                c = REPLACEMENT_CHARACTER; break;
-                            } 
-                            ch2 = (bp == bl) ? 0 : buffer[bp];
-                            if (c < 0xe0) {
-                                if (c < 0xc2) goto invalid;
-                                c ^= 0xc0; i = 1;
-                            } else if (c < 0xf0) {
-                                if ((c ^ 0xe0) == 0 && (ch2 ^ 0xa0) >= 0x20) goto invalid;
-                                c ^= 0xe0; i = 2;
-                            } else if (c < 0xf8) {
-                                if ((c ^ 0xf0) == 0 && (uint8_t)(ch2 - 0x90) >= 0x30) goto invalid;
-                                c ^= 0xf0; i = 3;
-                            } else if (c < 0xfc) {
-                                if ((c ^ 0xf8) == 0 && (uint8_t)(ch2 - 0x88) >= 0x38) goto invalid;
-                                c ^= 0xf8; i = 4;
-                            } else if (c < 0xfe) {
-                                if ((c ^ 0xfc) == 0 && (uint8_t)(ch2 - 0x84) >= 0x3c) goto invalid;
-                                c ^= 0xfc; i = 5;
-                            } else {
-                                if (type != E_UNKNOWN) goto invalid;
-                                if (c == 0xff && ch2 == 0xfe) type = E_UTF16LE;
-                                else if (c == 0xfe && ch2 == 0xff) type = E_UTF16BE;
-                                else goto invalid;
-                                bp = (bp + 1) % (BUFSIZ * 2);
-                                continue;
-                            }
-
-                            for (j = i; i != 0; i--) {
-                                if (bp != bl) {
-                                    ch2 = buffer[bp];
-                                    if ((ch2 ^ 0x80) < 0x40) {
-                                        c = (c << 6) ^ ch2 ^ 0x80;
-                                        bp = (bp + 1) % (BUFSIZ * 2);
-                                        continue;
-                                    }
-                                }
-                                if (type != E_UNKNOWN) {
-                                    c = REPLACEMENT_CHARACTER;break;
-                                }
-                                type = E_ISO;
-                                i = (j - i) * 6;
-                                qc = false;
-                                if (ubuff.p >= ubuff.len) {
-                                    ubuff.len += 16;
-                                    if (/*ubuff.len < 16 ||*/ ubuff.len > SIZE_MAX / sizeof *ubuff.data) err_msg_out_of_memory(); /* overflow */
-                                    ubuff.data = (uint32_t *)reallocx(ubuff.data, ubuff.len * sizeof *ubuff.data);
-                                }
-                                ubuff.data[ubuff.p++] = fromiso(((~0x7f >> j) & 0xff) | (c >> i));
-                                for (;i != 0; i-= 6) {
-                                    if (ubuff.p >= ubuff.len) {
-                                        ubuff.len += 16;
-                                        if (/*ubuff.len < 16 ||*/ ubuff.len > SIZE_MAX / sizeof *ubuff.data) err_msg_out_of_memory(); /* overflow */
-                                        ubuff.data = (uint32_t *)reallocx(ubuff.data, ubuff.len * sizeof *ubuff.data);
-                                    }
-                                    ubuff.data[ubuff.p++] = fromiso(((c >> (i-6)) & 0x3f) | 0x80);
-                                }
-                                if (bp == bl) goto eof;
-                                c = (ch2 >= 0x80) ? fromiso(ch2) : ch2; 
-                                j = 0;
-                                bp = (bp + 1) % (BUFSIZ * 2);
-                                break;
-                            }
-                            if (j != 0) type = E_UTF8;
-                            break;
-                        case E_UTF16LE:
-                            if (bp == bl) goto invalid;
-                            c |= buffer[bp] << 8; bp = (bp + 1) % (BUFSIZ * 2);
-                            if (c == 0xfffe) {
-                                type = E_UTF16BE;
-                                continue;
-                            }
-                            break;
-                        case E_UTF16BE:
-                            if (bp == bl) goto invalid;
-                            c = (c << 8) | buffer[bp]; bp = (bp + 1) % (BUFSIZ * 2);
-                            if (c == 0xfffe) {
-                                type = E_UTF16LE;
-                                continue;
-                            }
-                            break;
-                        case E_ISO:
-                            if (c >= 0x80) c = fromiso(c);
-                            goto done;
-                        }
-                        if (c == 0xfeff) continue;
-                        if (type != E_UTF8) {
-                            if (c >= 0xd800 && c < 0xdc00) {
-                                if (lastchar < 0xd800 || lastchar >= 0xdc00) continue;
-                                c = REPLACEMENT_CHARACTER;
-                            } else if (c >= 0xdc00 && c < 0xe000) {
-                                if (lastchar >= 0xd800 && lastchar < 0xdc00) {
-                                    c ^= 0x360dc00 ^ (lastchar << 10);
-                                    c += 0x10000;
-                                } else
-                                    c = REPLACEMENT_CHARACTER;
-                            } else if (lastchar >= 0xd800 && lastchar < 0xdc00) {
-                                c = REPLACEMENT_CHARACTER;
-                            }
-                        }
-                    done:
-                        if (c < 0xc0) {
-                            if (c == 10) {
-                                if (lastchar == 13) continue;
-                                break;
-                            } else if (c == 13) {
-                                break;
-                            }
-                            cclass = 0;
-                            if (!qc) {
-                                unfc(&ubuff);
-                                qc = true;
-                            }
-                            if (ubuff.p == 1) {
-                                if (ubuff.data[0] != 0 && ubuff.data[0] < 0x80) *p++ = ubuff.data[0]; else p = utf8out(ubuff.data[0], p);
-                            } else {
-                                p = flushubuff(&ubuff, p, tmp);
-                                ubuff.p = 1;
-                            }
-                            ubuff.data[0] = c;
-                        } else {
-                            const struct properties_s *prop = uget_property(c);
-                            uint8_t ncclass = prop->combclass;
-                            if ((ncclass != 0 && cclass > ncclass) || (prop->property & (qc_N | qc_M)) != 0) {
-                                qc = false;
-                                if (ubuff.p >= ubuff.len) {
-                                    ubuff.len += 16;
-                                    if (/*ubuff.len < 16 ||*/ ubuff.len > SIZE_MAX / sizeof *ubuff.data) err_msg_out_of_memory(); /* overflow */
-                                    ubuff.data = (uint32_t *)reallocx(ubuff.data, ubuff.len * sizeof *ubuff.data);
-                                }
-                                ubuff.data[ubuff.p++] = c;
-                            } else {
-                                if (!qc) {
-                                    unfc(&ubuff);
-                                    qc = true; 
-                                }
-                                if (ubuff.p == 1) {
-                                    if (ubuff.data[0] != 0 && ubuff.data[0] < 0x80) *p++ = ubuff.data[0]; else p = utf8out(ubuff.data[0], p);
-                                } else {
-                                    p = flushubuff(&ubuff, p, tmp);
-                                    ubuff.p = 1;
-                                }
-                                ubuff.data[0] = c;
-                            }
-                            cclass = ncclass;
-                        }
-                    }
-                eof:
-                    if (!qc) unfc(&ubuff);
-                    p = flushubuff(&ubuff, p, tmp);
-                    i = (p - tmp->data) - fp;
-                    p = tmp->data + fp;
-                    while (i != 0 && (p[i-1]==' ' || p[i-1]=='\t')) i--;
-                    p[i++] = 0;
-                    fp += i;
-                } while (bp != bl);
-#ifdef _WIN32
-                setlocale(LC_CTYPE, "C");
-#endif
-                free(ubuff.data);
-                tmp->lines = lines;
-                if (lines != max_lines) {
-                    tmp->line = (size_t *)reallocx(tmp->line, lines * sizeof *tmp->line);
-                }
+                err = file_read(tmp, f, ftype) ? 1 : 0;
             }
-            err = ferror(f);
             if (f != stdin) err |= fclose(f);
             if (err != 0 && errno != 0) err_msg_file(ERROR__READING_FILE, name, epoint);
-            tmp->len = fp;
-            tmp->data = (uint8_t *)reallocx(tmp->data, tmp->len);
-            tmp->coding = type;
+#ifdef PREFETCH_FILES
+            else if (ftype != 1) file_prefetch(tmp);
+#endif
         } else {
             const char *cmd_name = "<command line>";
             size_t cmdlen = strlen(cmd_name) + 1;
@@ -602,6 +1021,12 @@ struct file_s *openfile(const char* name, const char *base, int ftype, const Str
         free(base2);
         tmp = avltree_container_of(b, struct file_s, node);
         if ((tmp->type == 1) != (ftype == 1)) err_msg_file(ERROR__READING_FILE, name, epoint);
+#ifdef MAPPED_FILES
+        else if (tmp->mapped && !file_map_valid(tmp)) {
+            err_msg_file(ERROR__READING_FILE, name, epoint);
+            return NULL;
+        }
+#endif
     }
     tmp->open++;
     return tmp;
@@ -611,6 +1036,94 @@ void closefile(struct file_s *f) {
     if (f->open != 0) f->open--;
 }
 
+/* Lexer cache of the current line. Only available if the line is used
+   as it is, macro parameter substituted lines can't be cached. */
+struct lcache_s *get_lcache(struct file_s *cfile) {
+    line_t line = lpoint.line - 1;
+    if (line >= cfile->lines || pline != cfile->data + cfile->line[line]) return NULL;
+    if (cfile->lcache == NULL) {
+        line_t i;
+        cfile->lcache = (struct lcache_s *)mallocx(cfile->lines * sizeof *cfile->lcache);
+        for (i = 0; i < cfile->lines; i++) {
+            cfile->lcache[i].cmd = 0;
+            cfile->lcache[i].tokens = 0;
+            cfile->lcache[i].token = NULL;
+            cfile->lcache[i].expr = NULL;
+        }
+    }
+    return &cfile->lcache[line];
+}
+
+Obj *lcache_token(const struct lcache_s *lcache, linecpos_t pos, linecpos_t *end) {
+    size_t lo = 0, hi = lcache->tokens;
+    while (lo < hi) { /* tokens are ordered by position */
+        size_t i = lo + (hi - lo) / 2;
+        const struct ltoken_s *t = &lcache->token[i];
+        if (t->pos == pos) {
+            *end = t->end;
+            return val_reference(t->val);
+        }
+        if (t->pos < pos) lo = i + 1; else hi = i;
+    }
+    return NULL;
+}
+
+void lcache_add_token(struct lcache_s *lcache, linecpos_t pos, linecpos_t end, Obj *val) {
+    size_t i = lcache->tokens;
+    if ((i & (i - 1)) == 0) { /* grow at 0, 1, 2, 4, 8, ... */
+        size_t j = (i != 0) ? (i * 2) : 1;
+        if (j < i || j > SIZE_MAX / sizeof *lcache->token) err_msg_out_of_memory(); /* overflow */
+        lcache->token = (struct ltoken_s *)reallocx(lcache->token, j * sizeof *lcache->token);
+    }
+    while (i != 0 && lcache->token[i - 1].pos > pos) {
+        lcache->token[i] = lcache->token[i - 1];
+        i--;
+    }
+    lcache->token[i].pos = pos;
+    lcache->token[i].end = end;
+    lcache->token[i].val = val_reference(val);
+    lcache->tokens++;
+}
+
+struct lexpr_s *lcache_expr(const struct lcache_s *lcache, linecpos_t pos, int stop) {
+    struct lexpr_s *e;
+    for (e = lcache->expr; e != NULL; e = e->next) {
+        if (e->pos == pos && e->stop == stop) return e;
+    }
+    return NULL;
+}
+
+static struct lexprs_s {  /* compiled expressions are only freed at exit */
+    struct lexprs_s *next;
+    size_t len;
+    union {
+        struct lexpr_s expr;
+        struct lrpn_s rpn;
+    } data[1024];
+} *lexprs = NULL;
+
+/* Returns NULL for expressions too long to be cached */
+struct lexpr_s *lcache_add_expr(struct lcache_s *lcache, size_t len) {
+    struct lexpr_s *e;
+    size_t i, need;
+    if (len > lenof(lexprs->data) / 2) return NULL;
+    need = 1 + (len * sizeof(struct lrpn_s) + sizeof *lexprs->data - 1) / sizeof *lexprs->data;
+    if (lexprs == NULL || need > lenof(lexprs->data) - lexprs->len) {
+        struct lexprs_s *old = lexprs;
+        lexprs = (struct lexprs_s *)mallocx(sizeof *lexprs);
+        lexprs->next = old;
+        lexprs->len = 0;
+    }
+    i = lexprs->len;
+    lexprs->len += need;
+    e = &lexprs->data[i].expr;
+    e->rpn = &lexprs->data[i + 1].rpn;
+    e->len = len;
+    e->next = lcache->expr;
+    lcache->expr = e;
+    return e;
+}
+
 static struct stars_s {
     struct star_s stars[255];
     struct stars_s *next;
@@ -643,6 +1156,15 @@ struct star_s *new_star(line_t line, bool *exists) {
 void destroy_file(void) {
     struct stars_s *old;
 
+    if (file_reporter != NULL) {
+        const struct avltree_node *n;
+        for (n = avltree_first(&file_tree); n != NULL; n = avltree_next(n)) {
+            const struct file_s *a = cavltree_container_of(n, struct file_s, node);
+            if (a->type == 1 || dash_name(a->name) || a->lines == 0 || strchr(a->realname, '\n') != NULL) continue;
+            fprintf(file_reporter, "%d %08" PRIx32 " %s\n", arguments.toascii ? 1 : 0, a->hash, a->realname);
+        }
+    }
+
     avltree_destroy(&file_tree, file_free);
     free(lastfi);
     if (command_line != NULL) file_free(&command_line->node);
@@ -659,6 +1181,12 @@ void destroy_file(void) {
         stars = stars->next;
         free(old);
     }
+
+    while (lexprs != NULL) {
+        struct lexprs_s *old2 = lexprs;
+        lexprs = lexprs->next;
+        free(old2);
+    }
 }
 
 void init_file(void) {
@@ -669,6 +1197,59 @@ void init_file(void) {
     lastst = &stars->stars[starsp];
 }
 
+/* Bytes held by the source buffers, line tables and line caches */
+size_t file_memory(void) {
+    const struct avltree_node *n;
+    size_t sum = 0;
+    line_t i;
+
+    for (n = avltree_first(&file_tree); n != NULL; n = avltree_next(n)) {
+        const struct file_s *a = cavltree_container_of(n, struct file_s, node);
+        if (!a->mapped) sum += a->len;
+        sum += a->lines * sizeof *a->line;
+        if (a->lcache == NULL) continue;
+        sum += a->lines * sizeof *a->lcache;
+        for (i = 0; i < a->lines; i++) {
+            sum += a->lcache[i].tokens * sizeof *a->lcache[i].token;
+        }
+    }
+    return sum;
+}
+
+bool file_hashes_print(FILE *f) {
+    const struct avltree_node *n;
+
+    for (n = avltree_first(&file_tree); n != NULL; n = avltree_next(n)) {
+        const struct file_s *a = cavltree_container_of(n, struct file_s, node);
+        uint32_t hash = a->hash;
+        if (dash_name(a->name) || strchr(a->realname, '\n') != NULL) return false;
+#ifdef MAPPED_FILES
+        if (a->mapped) {
+            if (!file_map_valid(a)) return false;
+            hash = file_hash(hash, a->data, a->len); /* not read yet */
+        }
+#endif
+        fprintf(f, "file %08" PRIx32 " %s\n", hash, a->realname);
+    }
+    return true;
+}
+
+bool file_hash_check(const char *name, uint32_t hash) {
+    uint8_t buffer[BUFSIZ];
+    uint32_t h = FILE_HASH_INIT;
+    size_t l;
+    int err;
+    FILE *f = file_open(name, "rb");
+    if (f == NULL) return false;
+    do {
+        l = fread(buffer, 1, sizeof buffer, f);
+        h = file_hash(h, buffer, l);
+    } while (l == sizeof buffer);
+    err = ferror(f);
+    err |= fclose(f);
+    return err == 0 && h == hash;
+}
+
 void makefile(int argc, char *argv[]) {
     FILE *f;
     char *path;
@@ -27,14 +27,63 @@ enum filecoding_e {
     E_UNKNOWN, E_UTF8, E_UTF16LE, E_UTF16BE, E_ISO
 };
 
+struct Obj;
+
+struct ltoken_s {
+    linecpos_t pos, end;
+    struct Obj *val;
+};
+
+struct atom_s;
+struct Label;
+struct Namespace;
+
+struct lident_s {      /* last label lookup result of an identifier */
+    struct Label *label;
+    struct Namespace *context;
+    unsigned int generation;
+    uint8_t pass;
+    bool fixeddig;
+};
+
+struct lrpn_s {        /* compiled expression item */
+    linecpos_t pos;
+    uint8_t type;
+    int32_t arg;
+    struct Obj *val;
+    const struct atom_s *atom; /* interned identifier */
+    struct lident_s ident;
+};
+
+struct lexpr_s {        /* compiled expression */
+    struct lexpr_s *next;
+    linecpos_t pos, end;
+    int stop, wd;
+    size_t len;
+    struct lrpn_s *rpn;
+};
+
+struct lcache_s {      /* lexer results of a source line */
+    linecpos_t cmdpos; /* position of cached directive */
+    linecpos_t cmdend;
+    uint8_t cmd;       /* directive + 1, 0 if not known yet */
+    size_t tokens;
+    struct ltoken_s *token;
+    struct lexpr_s *expr;
+};
+
 struct file_s {
     const char *name;
     const char *realname;
     const char *base;
     size_t *line;
     line_t lines;
+    struct lcache_s *lcache;
     uint8_t *data;    /* data */
     size_t len;       /* length */
+    uint32_t hash;    /* hash of raw content */
+    bool mapped;      /* data is a read only file mapping */
+    int mapfd;        /* descriptor of the mapped file */
     uint16_t open;    /* open/not open */
     uint16_t uid;     /* uid */
     int type;
@@ -43,6 +92,8 @@ struct file_s {
     struct avltree_node node;
 };
 
+#define FILE_HASH_INIT 2166136261U
+
 struct star_s {
     line_t line;
     address_t addr;
@@ -58,12 +109,26 @@ struct Str;
 
 extern struct file_s *openfile(const char *, const char *, int, const struct Str *, linepos_t);
 extern void closefile(struct file_s*);
+extern struct lcache_s *get_lcache(struct file_s *);
+extern struct Obj *lcache_token(const struct lcache_s *, linecpos_t, linecpos_t *);
+extern void lcache_add_token(struct lcache_s *, linecpos_t, linecpos_t, struct Obj *);
+extern struct lexpr_s *lcache_expr(const struct lcache_s *, linecpos_t, int);
+extern struct lexpr_s *lcache_add_expr(struct lcache_s *, size_t);
 extern struct star_s *new_star(line_t, bool *);
 extern void destroy_file(void);
 extern void init_file(void);
 extern FILE *file_open(const char *, const char *);
 extern void include_list_add(const char *);
+extern uint32_t include_list_hash(uint32_t);
 extern char *get_path(const struct Str *, const char *);
 extern void makefile(int, char *[]);
+extern uint32_t file_hash(uint32_t, const uint8_t *, size_t);
+extern bool file_hashes_print(FILE *);
+extern size_t file_memory(void);
+extern bool file_hash_check(const char *, uint32_t);
+extern void file_cache_init(void);
+extern void file_cache_add(const char *, bool, uint32_t);
+extern void file_cache_destroy(void);
+extern void file_report(FILE *);
 
 #endif
@@ -34,12 +34,22 @@
 #include "longjump.h"
 #include "arguments.h"
 #include "optimizer.h"
+#include "profile.h"
 
 static const uint32_t *mnemonic;    /* mnemonics */
 static const uint8_t *opcode;       /* opcodes */
-static unsigned int last_mnem;
 static const struct cpu_s *cpu;
 
+/* Mnemonics are three letters, the low 5 bits of each is a collision free
+   index into this table. It holds the mnemonic number + 1 of the current
+   processor, or 0 if there's no such mnemonic. */
+static uint8_t mnemonic_hash[0x8000];
+static const struct cpu_s *mnemonic_hash_cpu;
+
+static inline unsigned int mnemonic_slot(uint32_t name) {
+    return ((name >> 6) & 0x7c00) | ((name >> 3) & 0x3e0) | (name & 0x1f);
+}
+
 bool longaccu = false, longindex = false, autosize = false; /* hack */
 uint32_t dpage = 0;
 unsigned int databank = 0;
@@ -47,24 +57,25 @@ bool longbranchasjmp = false;
 bool allowslowbranch = true;
 
 int lookup_opcode(const uint8_t *s) {
-    int32_t s4;
-    unsigned int also, felso, elozo, no;
+    unsigned int no;
     uint32_t name;
 
     name = ((uint32_t)s[0] << 16) | (s[1] << 8) | s[2];
     if (arguments.caseinsensitive != 0) name |= 0x202020;
-    also = 0;
-    no = (felso = last_mnem) / 2;
-    for (;;) {  /* do binary search */
-        if ((s4 = name - mnemonic[no]) == 0) return no;
-        elozo = no;
-        if (elozo == (no = ((s4 > 0) ? (felso + (also = no)) : (also + (felso = no))) / 2)) break;
-    }
-    return -1;
+    no = mnemonic_hash[mnemonic_slot(name)];
+    if (no == 0 || mnemonic[no - 1] != name) return -1;
+    return (int)no - 1;
 }
 
 void select_opcodes(const struct cpu_s *cpumode) {
-    last_mnem = cpumode->opcodes;
+    if (mnemonic_hash_cpu != cpumode) {
+        unsigned int i;
+        memset(mnemonic_hash, 0, sizeof mnemonic_hash);
+        for (i = 0; i < cpumode->opcodes; i++) {
+            mnemonic_hash[mnemonic_slot(cpumode->mnemonic[i])] = (uint8_t)(i + 1);
+        }
+        mnemonic_hash_cpu = cpumode;
+    }
     mnemonic = cpumode->mnemonic; 
     opcode = cpumode->opcode;
     cpu = cpumode;
@@ -489,6 +500,7 @@ MUST_CHECK Error *instruction(int prm, int w, Obj *vals, linepos_t epoint, struc
                             branchend:
                                 if (labelexists && s->addr != ((current_section->l_address.address & 0xffff) | current_section->l_address.bank)) {
                                     if (fixeddig && pass > max_pass) err_msg_cant_calculate(NULL, epoint);
+                                    trace_address(TRACE_STAR, NULL, epoint, s->addr, (current_section->l_address.address & 0xffff) | current_section->l_address.bank);
                                     fixeddig = false;
                                 }
                                 s->addr = (current_section->l_address.address & 0xffff) | current_section->l_address.bank;
@@ -551,6 +563,7 @@ MUST_CHECK Error *instruction(int prm, int w, Obj *vals, linepos_t epoint, struc
             branchok:
                 if (labelexists && s->addr != ((star + 1 + ln) & all_mem)) {
                     if (fixeddig && pass > max_pass) err_msg_cant_calculate(NULL, epoint);
+                    trace_address(TRACE_STAR, NULL, epoint, s->addr, (star + 1 + ln) & all_mem);
                     fixeddig = false;
                 }
                 s->addr = (star + 1 + ln) & all_mem;
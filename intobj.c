@@ -47,6 +47,24 @@ Type *INT_OBJ = &obj;
 Int *int_value[2];
 Int *minus1_value;
 
+/* Values in this range are shared instead of being allocated each time,
+   address arithmetic mostly stays in it. Created on first use. */
+#define SMALL_INT_MIN (-256)
+#define SMALL_INT_MAX 65535
+static Int *small_int[SMALL_INT_MAX - SMALL_INT_MIN + 1];
+
+static MUST_CHECK Int *small_int_value(int i) {
+    Int *v = small_int[i - SMALL_INT_MIN];
+    if (v == NULL) {
+        v = new_int();
+        v->data = v->val;
+        v->val[0] = (i < 0) ? -i : i;
+        v->len = (i < 0) ? -1 : (i != 0) ? 1 : 0;
+        small_int[i - SMALL_INT_MIN] = v;
+    }
+    return ref_int(v);
+}
+
 static inline size_t intlen(const Int *v1) {
     ssize_t len = v1->len;
     return (len < 0) ? -len : len;
@@ -111,6 +129,7 @@ static MUST_CHECK Int *return_int(digit_t c, bool neg) {
     Int *vv;
     digit_t *v;
     if (c == 0) return ref_int(int_value[0]);
+    if (c <= (neg ? (digit_t)-SMALL_INT_MIN : (digit_t)SMALL_INT_MAX)) return small_int_value(neg ? -(int)c : (int)c);
     vv = new_int();
     vv->data = v = vv->val;
     v[0] = c;
@@ -118,6 +137,17 @@ static MUST_CHECK Int *return_int(digit_t c, bool neg) {
     return vv;
 }
 
+static MUST_CHECK Int *return_twodigits(twodigits_t c, bool neg) {
+    Int *vv;
+    if (c <= MASK) return return_int((digit_t)c, neg);
+    vv = new_int();
+    vv->data = vv->val;
+    vv->val[0] = (digit_t)c;
+    vv->val[1] = (digit_t)(c >> (8 * sizeof(digit_t)));
+    vv->len = neg ? -2 : 2;
+    return vv;
+}
+
 static bool same(const Obj *o1, const Obj *o2) {
     const Int *v1 = (const Int *)o1, *v2 = (const Int *)o2;
     if (o2->obj != INT_OBJ || v1->len != v2->len) return false;
@@ -648,8 +678,11 @@ static MUST_CHECK Int *power(const Int *vv1, const Int *vv2) {
     int j;
     bool neg = false;
     size_t i;
-    Int *v = int_from_int(1);
+    Int *v = new_int(); /* modified in place, can't be a shared one */
 
+    v->data = v->val;
+    v->val[0] = 1;
+    v->len = 1;
     for (i = vv2->len; (i--) != 0;) {
         digit_t d = vv2->data[i];
         for (j = SHIFT - 1; j >= 0; j--) {
@@ -1082,7 +1115,9 @@ static ssize_t icmp(const Int *vv1, const Int *vv2) {
 }
 
 MUST_CHECK Int *int_from_int(int i) {
-    Int *v = new_int();
+    Int *v;
+    if (i >= SMALL_INT_MIN && i <= SMALL_INT_MAX) return small_int_value(i);
+    v = new_int();
     v->data = v->val;
     if (i < 0) {
         v->val[0] = -i;
@@ -1098,6 +1133,7 @@ MUST_CHECK Int *int_from_size(size_t i) {
     unsigned int j;
     Int *v;
     if (i < lenof(int_value)) return ref_int(int_value[i]);
+    if (i <= SMALL_INT_MAX) return small_int_value((int)i);
     v = new_int();
     v->data = v->val;
     v->val[0] = i;
@@ -1116,7 +1152,9 @@ MUST_CHECK Int *int_from_uval(uval_t i) {
 }
 
 MUST_CHECK Int *int_from_ival(ival_t i) {
-    Int *v = new_int();
+    Int *v;
+    if (i >= SMALL_INT_MIN && i <= SMALL_INT_MAX) return small_int_value((int)i);
+    v = new_int();
     v->data = v->val;
     if (i < 0) {
         v->val[0] = -i;
@@ -1408,12 +1446,44 @@ MUST_CHECK Int *int_from_decstr(const uint8_t *s, size_t *ln, size_t *ln2) {
     return (Int *)normalize(v, d, sz, false);
 }
 
+/* Operands of at most one digit, without the general multi digit code */
+static MUST_CHECK Obj *calc2_small(oper_t op, const Int *v1, const Int *v2) {
+    twodigits_t m1 = (v1->len != 0) ? v1->data[0] : 0;
+    twodigits_t m2 = (v2->len != 0) ? v2->data[0] : 0;
+    bool n1 = v1->len < 0, n2 = v2->len < 0;
+    switch (op->op->op) {
+    case O_SUB:
+        n2 = !n2;
+        /* fall through */
+    case O_ADD:
+        if (n1 == n2) return (Obj *)return_twodigits(m1 + m2, n1);
+        if (m1 >= m2) return (Obj *)return_twodigits(m1 - m2, n1);
+        return (Obj *)return_twodigits(m2 - m1, n2);
+    case O_MUL: return (Obj *)return_twodigits(m1 * m2, n1 != n2);
+    case O_AND: return (Obj *)return_int((digit_t)(m1 & m2), false);
+    case O_OR: return (Obj *)return_int((digit_t)(m1 | m2), false);
+    case O_XOR: return (Obj *)return_int((digit_t)(m1 ^ m2), false);
+    default: return NULL;
+    }
+}
+
 static MUST_CHECK Obj *calc2_int(oper_t op) {
     Int *v1 = (Int *)op->v1, *v2 = (Int *)op->v2, *v;
     Error *err;
     Obj *val;
     ival_t shift;
     ssize_t cmp;
+    if (v1->len >= 0 && v1->len <= 1 && v2->len >= 0 && v2->len <= 1) {
+        val = calc2_small(op, v1, v2);
+        if (val != NULL) return val;
+    } else if (v1->len >= -1 && v1->len <= 1 && v2->len >= -1 && v2->len <= 1) {
+        switch (op->op->op) {
+        case O_ADD:
+        case O_SUB:
+        case O_MUL: return calc2_small(op, v1, v2);
+        default: break;
+        }
+    }
     switch (op->op->op) {
     case O_CMP:
         cmp = icmp(v1, v2);
@@ -1598,6 +1668,7 @@ void intobj_names(void) {
 }
 
 void intobj_destroy(void) {
+    size_t i;
 #ifdef DEBUG
     if (int_value[0]->v.refcount != 1) fprintf(stderr, "int[0] %" PRIuSIZE "\n", int_value[0]->v.refcount - 1);
     if (int_value[1]->v.refcount != 1) fprintf(stderr, "int[1] %" PRIuSIZE "\n", int_value[1]->v.refcount - 1);
@@ -1607,4 +1678,7 @@ void intobj_destroy(void) {
     val_destroy(&int_value[0]->v);
     val_destroy(&int_value[1]->v);
     val_destroy(&minus1_value->v);
+    for (i = 0; i < lenof(small_int); i++) {
+        if (small_int[i] != NULL) val_destroy(&small_int[i]->v);
+    }
 }
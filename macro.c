@@ -33,6 +33,7 @@
 #include "namespaceobj.h"
 #include "arguments.h"
 #include "optimizer.h"
+#include "profile.h"
 
 static Type macro_obj;
 static Type segment_obj;
@@ -323,7 +324,9 @@ Obj *macro_recurse(enum wait_e t, Obj *tmp2, Namespace *context, linepos_t epoin
     }
     if (t == W_ENDS) {
         if (context != NULL) push_context(context);
+        profile_enter(PROFILE_MACRO, macro->file_list->file, macro->line);
         val = compile(macro->file_list);
+        profile_exit();
         if (context != NULL) pop_context();
     } else {
         line_t lin = lpoint.line;
@@ -337,6 +340,7 @@ Obj *macro_recurse(enum wait_e t, Obj *tmp2, Namespace *context, linepos_t epoin
         if (diagnostics.optimize) cpu_opt_invalidate();
         if (labelexists && s->addr != star) {
             if (fixeddig && pass > max_pass) err_msg_cant_calculate(NULL, &lpoint);
+            trace_address(TRACE_STAR, NULL, &lpoint, s->addr, star);
             fixeddig = false;
         }
         s->addr = star;
@@ -345,7 +349,9 @@ Obj *macro_recurse(enum wait_e t, Obj *tmp2, Namespace *context, linepos_t epoin
         lpoint.line = macro->line;
         new_waitfor(t, &nopoint);
         if (context != NULL) push_context(context);
+        profile_enter(PROFILE_MACRO, macro->file_list->file, macro->line);
         val = compile(cflist);
+        profile_exit();
         if (context != NULL) pop_context();
         star = s->addr;
         exitfile();
@@ -425,6 +431,7 @@ Obj *mfunc_recurse(enum wait_e t, Mfunc *mfunc, Namespace *context, linepos_t ep
         if (diagnostics.optimize) cpu_opt_invalidate();
         if (labelexists && s->addr != star) {
             if (fixeddig && pass > max_pass) err_msg_cant_calculate(NULL, &lpoint);
+            trace_address(TRACE_STAR, NULL, &lpoint, s->addr, star);
             fixeddig = false;
         }
         s->addr = star;
@@ -438,7 +445,9 @@ Obj *mfunc_recurse(enum wait_e t, Mfunc *mfunc, Namespace *context, linepos_t ep
         }
         push_context(context);
         functionrecursion++;
+        profile_enter(PROFILE_FUNCTION, mfunc->file_list->file, mfunc->line);
         val = compile(cflist);
+        profile_exit();
         functionrecursion--;
         context_set_bottom(oldbottom);
         pop_context();
@@ -675,6 +684,7 @@ Obj *mfunc2_recurse(Mfunc *mfunc, struct values_s *vals, unsigned int args, line
         if (diagnostics.optimize) cpu_opt_invalidate();
         if (labelexists && s->addr != star) {
             if (fixeddig && pass > max_pass) err_msg_cant_calculate(NULL, &lpoint);
+            trace_address(TRACE_STAR, NULL, &lpoint, s->addr, star);
             fixeddig = false;
         }
         s->addr = star;
@@ -698,7 +708,9 @@ Obj *mfunc2_recurse(Mfunc *mfunc, struct values_s *vals, unsigned int args, line
         current_section->l_address_val = (oldsection->l_address_val != NULL) ? val_reference(oldsection->l_address_val) : NULL;
         current_section->dooutput = false;
         functionrecursion++;
+        profile_enter(PROFILE_FUNCTION, mfunc->file_list->file, mfunc->line);
         retval = compile(cflist);
+        profile_exit();
         functionrecursion--;
         current_section = oldsection;
         context_set_bottom(oldbottom);
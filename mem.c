@@ -194,6 +194,27 @@ static void padding(size_t size, FILE *f) {
 err:while ((size--) != 0) if (putc(0, f) == EOF) break;
 }
 
+/*
+ * write a block, long runs of zeros are seeked over like padding
+ */
+static bool putblock(const uint8_t *data, size_t len, FILE *f) {
+    size_t i, j, k = 0;
+    if (len == 0) return true;
+    len--; /* the last byte is always written so that the file ends here */
+    for (i = 0; i < len; i = j) {
+        if (data[i] != 0) {
+            j = i + 1;
+            continue;
+        }
+        for (j = i + 1; j < len && data[j] == 0; j++);
+        if (j - i < 0x1000) continue;
+        if (i != k && fwrite(data + k, i - k, 1, f) == 0) return false;
+        padding(j - i, f);
+        k = j;
+    }
+    return fwrite(data + k, len + 1 - k, 1, f) != 0;
+}
+
 static void output_mem_c64(FILE *fout, const struct memblocks_s *memblocks) {
     address_t pos, end;
     unsigned int i;
@@ -213,7 +234,7 @@ static void output_mem_c64(FILE *fout, const struct memblocks_s *memblocks) {
         for (i = 0; i < memblocks->p; i++) {
             const struct memblock_s *block = &memblocks->data[i];
             padding(block->addr - pos, fout);
-            if (fwrite(memblocks->mem.data + block->p, block->len, 1, fout) == 0) return;
+            if (!putblock(memblocks->mem.data + block->p, block->len, fout)) return;
             pos = block->addr + block->len;
         }
     }
@@ -265,7 +286,7 @@ static void output_mem_flat(FILE *fout, const struct memblocks_s *memblocks) {
     for (pos = i = 0; i < memblocks->p; i++) {
         const struct memblock_s *block = &memblocks->data[i];
         padding(block->addr - pos, fout);
-        if (fwrite(memblocks->mem.data + block->p, block->len, 1, fout) == 0) return;
+        if (!putblock(memblocks->mem.data + block->p, block->len, fout)) return;
         pos = block->addr + block->len;
     }
 }
@@ -504,6 +525,21 @@ void output_mem(struct memblocks_s *memblocks) {
     }
 }
 
+/* Room for len bytes of output, to be filled in by the caller */
+uint8_t *alloc_mem(struct memblocks_s *memblocks, size_t len) {
+    uint8_t *d;
+    if (len > memblocks->mem.len - memblocks->mem.p) {
+        memblocks->mem.len = memblocks->mem.p + len;
+        if (memblocks->mem.len < len) err_msg_out_of_memory(); /* overflow */
+        memblocks->mem.len += 0x1000;
+        if (memblocks->mem.len < 0x1000) err_msg_out_of_memory(); /* overflow */
+        memblocks->mem.data = (uint8_t *)reallocx(memblocks->mem.data, memblocks->mem.len);
+    }
+    d = memblocks->mem.data + memblocks->mem.p;
+    memblocks->mem.p += len;
+    return d;
+}
+
 void write_mem(struct memblocks_s *memblocks, uint8_t c) {
     if (memblocks->mem.p >= memblocks->mem.len) {
         memblocks->mem.len += 0x1000;
@@ -608,6 +644,10 @@ void init_memblocks(struct memblocks_s *memblocks) {
     memblocks->compressed = false;
 }
 
+size_t memblocks_memory(const struct memblocks_s *memblocks) {
+    return memblocks->mem.len + memblocks->len * sizeof *memblocks->data;
+}
+
 void destroy_memblocks(struct memblocks_s *memblocks) {
     free(memblocks->mem.data);
     free(memblocks->data);
@@ -43,9 +43,11 @@ extern void memref(struct memblocks_s *, struct memblocks_s *);
 extern void memprint(struct memblocks_s *);
 extern void output_mem(struct memblocks_s *);
 extern void write_mem(struct memblocks_s *, uint8_t);
+extern uint8_t *alloc_mem(struct memblocks_s *, size_t);
 extern int16_t read_mem(const struct memblocks_s *, size_t, size_t, size_t);
 extern void get_mem(const struct memblocks_s *, size_t *, size_t *);
 extern void restart_memblocks(struct memblocks_s *, address_t);
 extern void init_memblocks(struct memblocks_s *);
 extern void destroy_memblocks(struct memblocks_s *);
+extern size_t memblocks_memory(const struct memblocks_s *);
 #endif
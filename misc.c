@@ -31,6 +31,7 @@
 #include "values.h"
 #include "arguments.h"
 #include "opt_bit.h"
+#include "profile.h"
 
 #include "namespaceobj.h"
 
@@ -149,9 +150,9 @@ void tfree(void) {
     err_destroy();
     destroy_encoding();
     destroy_values();
-    destroy_namespacekeys();
     destroy_ternary();
     destroy_opt_bit();
+    destroy_profile();
     unfc(NULL);
     unfkc(NULL, NULL, 0);
     str_cfcpy(NULL, NULL);
@@ -167,5 +168,6 @@ void tinit(const char *prgname) {
     init_eval();
     init_ternary();
     init_opt_bit();
+    init_profile();
 }
 
@@ -18,6 +18,7 @@
 */
 #include "namespaceobj.h"
 #include <string.h>
+#include "misc.h"
 #include "variables.h"
 #include "eval.h"
 #include "intobj.h"
@@ -32,60 +33,105 @@ static Type obj;
 
 Type *NAMESPACE_OBJ = &obj;
 
-static void namespace_free(struct avltree_node *aa)
-{
-    struct namespacekey_s *a = avltree_container_of(aa, struct namespacekey_s, node);
-    val_destroy(&a->key->v);
-    namespacekey_free(a);
-}
-
-static void namespace_free2(struct avltree_node *aa)
-{
-    struct namespacekey_s *a = avltree_container_of(aa, struct namespacekey_s, node);
-    namespacekey_free(a);
-}
-
-static void garbage1(struct avltree_node *aa)
-{
-    struct namespacekey_s *a = avltree_container_of(aa, struct namespacekey_s, node);
-    a->key->v.refcount--;
-}
-
-static void garbage2(struct avltree_node *aa)
-{
-    struct namespacekey_s *a = avltree_container_of(aa, struct namespacekey_s, node);
-    Obj *v = &a->key->v;
-    if ((v->refcount & SIZE_MSB) != 0) {
-        v->refcount -= SIZE_MSB - 1;
-        v->obj->garbage(v, 1);
-    } else v->refcount++;
-}
-
 static void destroy(Obj *o1) {
     Namespace *v1 = (Namespace *)o1;
-    avltree_destroy(&v1->members, namespace_free);
+    size_t i;
+    if (v1->data == NULL) return;
+    label_generation++;
+    for (i = 0; i <= v1->mask; i++) {
+        if (v1->data[i].key != NULL) val_destroy(&v1->data[i].key->v);
+    }
+    free(v1->data);
 }
 
-static void garbage(Obj *o1, int i) {
+static void garbage(Obj *o1, int j) {
     Namespace *v1 = (Namespace *)o1;
-    switch (i) {
+    size_t i;
+    Obj *v;
+    if (v1->data == NULL) return;
+    switch (j) {
     case -1:
-        avltree_destroy(&v1->members, garbage1);
+        for (i = 0; i <= v1->mask; i++) {
+            if (v1->data[i].key != NULL) v1->data[i].key->v.refcount--;
+        }
         return;
     case 0:
-        avltree_destroy(&v1->members, namespace_free2);
+        label_generation++;
+        free(v1->data);
         return;
     case 1:
-        avltree_destroy(&v1->members, garbage2);
+        for (i = 0; i <= v1->mask; i++) {
+            if (v1->data[i].key == NULL) continue;
+            v = &v1->data[i].key->v;
+            if ((v->refcount & SIZE_MSB) != 0) {
+                v->refcount -= SIZE_MSB - 1;
+                v->obj->garbage(v, 1);
+            } else v->refcount++;
+        }
         return;
     }
 }
 
+/* Same order as the members were kept in before, by hash, name and
+   strength. Used where the output should not depend on the table layout. */
+static int namespacekey_sort(const void *aa, const void *bb) {
+    const struct namespacekey_s *a = *(const struct namespacekey_s * const *)aa;
+    const struct namespacekey_s *b = *(const struct namespacekey_s * const *)bb;
+    int h = a->hash - b->hash;
+    if (h != 0) return h;
+    h = str_cmp(&a->key->cfname, &b->key->cfname);
+    if (h != 0) return h;
+    return b->key->strength - a->key->strength;
+}
+
+struct namespacekey_s **namespace_sorted(const Namespace *ns, size_t *ln) {
+    struct namespacekey_s **list;
+    size_t i, j = 0;
+    if (ns->data == NULL) {
+        *ln = 0;
+        return NULL;
+    }
+    if (ns->mask >= SIZE_MAX / sizeof *list) err_msg_out_of_memory(); /* overflow */
+    list = (struct namespacekey_s **)mallocx((ns->mask + 1) * sizeof *list);
+    for (i = 0; i <= ns->mask; i++) {
+        if (ns->data[i].key != NULL) list[j++] = &ns->data[i];
+    }
+    qsort(list, j, sizeof *list, namespacekey_sort);
+    *ln = j;
+    return list;
+}
+
+static void namespace_grow(Namespace *ns) {
+    struct namespacekey_s *old = ns->data;
+    size_t i, oldmask = ns->mask;
+    size_t size = (old == NULL) ? 8 : (oldmask + 1) * 2;
+    if (size < 8 || size > SIZE_MAX / sizeof *ns->data) err_msg_out_of_memory(); /* overflow */
+    ns->data = (struct namespacekey_s *)mallocx(size * sizeof *ns->data);
+    ns->mask = size - 1;
+    for (i = 0; i < size; i++) ns->data[i].key = NULL;
+    if (old == NULL) return;
+    for (i = 0; i <= oldmask; i++) {
+        size_t j;
+        if (old[i].key == NULL) continue;
+        for (j = namespace_slot(ns, old[i].hash); ns->data[j].key != NULL; j = (j + 1) & ns->mask);
+        ns->data[j] = old[i];
+    }
+    free(old);
+}
+
+/* The label must not be a member yet */
+void namespace_insert(Namespace *ns, int hash, Label *label) {
+    size_t i;
+    if (ns->data == NULL || ns->len >= ns->mask - (ns->mask >> 2)) namespace_grow(ns);
+    for (i = namespace_slot(ns, hash); ns->data[i].key != NULL; i = (i + 1) & ns->mask);
+    ns->data[i].hash = hash;
+    ns->data[i].key = label;
+    ns->len++;
+}
+
 static struct oper_s pair_oper;
-static int namespacekey_compare(const struct avltree_node *aa, const struct avltree_node *bb)
+static int namespacekey_compare(const struct namespacekey_s *a, const struct namespacekey_s *b)
 {
-    const struct namespacekey_s *a = cavltree_container_of(aa, struct namespacekey_s, node);
-    const struct namespacekey_s *b = cavltree_container_of(bb, struct namespacekey_s, node);
     Obj *result;
     int h = a->hash - b->hash;
 
@@ -101,17 +147,19 @@ static int namespacekey_compare(const struct avltree_node *aa, const struct avlt
 
 static bool same(const Obj *o1, const Obj *o2) {
     const Namespace *v1 = (const Namespace *)o1, *v2 = (const Namespace *)o2;
-    const struct avltree_node *n;
-    const struct avltree_node *n2;
+    struct namespacekey_s **list, **list2;
+    size_t i, ln, ln2;
+    bool ret;
     if (o2->obj != NAMESPACE_OBJ) return false;
-    n = avltree_first(&v1->members);
-    n2 = avltree_first(&v2->members);
-    while (n != NULL && n2 != NULL) {
-        if (namespacekey_compare(n, n2) != 0) return false;
-        n = avltree_next(n);
-        n2 = avltree_next(n2);
+    list = namespace_sorted(v1, &ln);
+    list2 = namespace_sorted(v2, &ln2);
+    ret = (ln == ln2);
+    for (i = 0; ret && i < ln; i++) {
+        if (namespacekey_compare(list[i], list2[i]) != 0) ret = false;
     }
-    return n == n2;
+    free(list);
+    free(list2);
+    return ret;
 }
 
 static MUST_CHECK Obj *repr(Obj *o1, linepos_t epoint, size_t maxsize) {
@@ -131,14 +179,15 @@ static MUST_CHECK Obj *repr(Obj *o1, linepos_t epoint, size_t maxsize) {
         tuple->data = vals = list_create_elements(tuple, ln);
         ln = chars;
         if (v1->len != 0) {
-            const struct avltree_node *n;
-            for (n = avltree_first(&v1->members); n != NULL; n = avltree_next(n)) {
-                const struct namespacekey_s *p = cavltree_container_of(n, struct namespacekey_s, node);
-                Obj *key = (Obj *)p->key;
+            size_t n, len2;
+            struct namespacekey_s **list = namespace_sorted(v1, &len2);
+            for (n = 0; n < len2; n++) {
+                Obj *key = (Obj *)list[n]->key;
                 Obj *v = key->obj->repr(key, epoint, maxsize - chars);
                 if (v == NULL || v->obj != STR_OBJ) {
                     tuple->len = i;
                     val_destroy(&tuple->v);
+                    free(list);
                     return v;
                 }
                 str = (Str *)v;
@@ -149,10 +198,12 @@ static MUST_CHECK Obj *repr(Obj *o1, linepos_t epoint, size_t maxsize) {
                     tuple->len = i;
                     val_destroy(&tuple->v);
                     val_destroy(v);
+                    free(list);
                     return NULL;
                 }
                 vals[i++] = v;
             }
+            free(list);
         }
         tuple->len = i;
     }
@@ -181,7 +232,7 @@ MUST_CHECK Obj *namespace_member(oper_t op, Namespace *v1) {
     case T_IDENT:
         {
             Ident *v2 = (Ident *)o2;
-            l = find_label2(&v2->name, v1);
+            l = find_atom2(v2->atom, v1, v2->cache);
             if (l != NULL) {
                 touch_label(l);
                 return val_reference(l->value);
@@ -224,7 +275,8 @@ MUST_CHECK Obj *namespace_member(oper_t op, Namespace *v1) {
 
 MUST_CHECK Namespace *new_namespace(const struct file_list_s *file_list, linepos_t epoint) {
     Namespace *val = (Namespace *)val_alloc(NAMESPACE_OBJ);
-    avltree_init(&val->members);
+    val->data = NULL;
+    val->mask = 0;
     val->file_list = file_list;
     val->epoint = *epoint;
     val->len = 0;
@@ -246,51 +298,3 @@ void namespaceobj_init(void) {
     pair_oper.epoint2 = &nopoint;
     pair_oper.epoint3 = &nopoint;
 }
-
-#define SLOTS 128
-
-static void *namespacekeys;
-#ifndef DEBUG
-static void *namespacekey_next;
-#endif
-
-void namespacekey_free(struct namespacekey_s *val) {
-#ifdef DEBUG
-    free(val);
-#else
-    *((void **)val) = namespacekey_next;
-    namespacekey_next = (void *)val;
-#endif
-}
-
-struct namespacekey_s *namespacekey_alloc(void) {
-#ifdef DEBUG
-    struct namespacekey_s *val = (struct namespacekey_s *)mallocx(sizeof *val);
-#else
-    struct namespacekey_s *val = (struct namespacekey_s *)namespacekey_next;
-    if (val == NULL) {
-        size_t i;
-        uint8_t *n = (uint8_t *)mallocx(sizeof(void *) + sizeof(struct namespacekey_s) * SLOTS);
-        *((void **)n) = namespacekeys;
-        namespacekeys = (void *)n;
-        n += sizeof(void *);
-        val = (struct namespacekey_s *)n;
-        for (i = 0; i < (SLOTS - 1); i++, n += sizeof(struct namespacekey_s)) {
-            *((void **)n) = (void *)(n + sizeof(struct namespacekey_s));
-        }
-        *((void **)n) = NULL;
-    }
-    namespacekey_next = *(void **)val;
-#endif
-    return val;
-}
-
-void destroy_namespacekeys(void) {
-    void *n = namespacekeys, *n2;
-    while (n != NULL) {
-        n2 = *((void **)n);
-        free(n);
-        n = n2;
-    }
-}
-
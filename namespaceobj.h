@@ -19,14 +19,16 @@
 #ifndef NAMESPACEOBJ_H
 #define NAMESPACEOBJ_H
 #include "obj.h"
-#include "avl.h"
 
 extern struct Type *NAMESPACE_OBJ;
 
+struct namespacekey_s;
+
 typedef struct Namespace {
     Obj v;
     size_t len;
-    struct avltree members;
+    size_t mask;
+    struct namespacekey_s *data;
     const struct file_list_s *file_list;
     struct linepos_s epoint;
 } Namespace;
@@ -38,9 +40,15 @@ struct Label;
 struct namespacekey_s {
     int hash;
     struct Label *key;
-    struct avltree_node node;
 };
 
+/* Members are in an open addressing hash table with linear probing, there
+   might be more labels with the same name but different strength. */
+static inline size_t namespace_slot(const Namespace *ns, int hash) {
+    unsigned int h = (unsigned int)hash;
+    return (h ^ (h >> 11) ^ (h >> 22)) & ns->mask;
+}
+
 static inline Namespace *ref_namespace(Namespace *v1) {
     v1->v.refcount++; return v1;
 }
@@ -48,7 +56,6 @@ static inline Namespace *ref_namespace(Namespace *v1) {
 extern MUST_CHECK Namespace *new_namespace(const struct file_list_s *, linepos_t);
 extern MUST_CHECK Obj *namespace_member(struct oper_s *, Namespace *);
 
-extern void namespacekey_free(struct namespacekey_s *);
-extern struct namespacekey_s *namespacekey_alloc(void);
-extern void destroy_namespacekeys(void);
+extern void namespace_insert(Namespace *, int, struct Label *);
+extern struct namespacekey_s **namespace_sorted(const Namespace *, size_t *);
 #endif
@@ -85,9 +85,14 @@ typedef struct Funcargs {
     struct values_s *val;
 } Funcargs;
 
+struct atom_s;
+struct lident_s;
+
 typedef struct Ident {
     Obj v;
     str_t name;
+    const struct atom_s *atom;
+    struct lident_s *cache;
     struct linepos_s epoint;
 } Ident;
 
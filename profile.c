@@ -0,0 +1,640 @@
+/*
+    $Id$
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+*/
+#include "profile.h"
+#include <string.h>
+#include <time.h>
+#include "file.h"
+#include "error.h"
+#include "unicode.h"
+#include "arguments.h"
+#include "64tass.h"
+#include "values.h"
+#include "strobj.h"
+#include "typeobj.h"
+#include "section.h"
+#include "variables.h"
+
+#if _POSIX_TIMERS > 0 && defined CLOCK_MONOTONIC
+#define PROFILE_MONOTONIC
+#endif
+
+#define PROFILE_TOP 20
+
+size_t profile_lines;
+
+struct profile_s {
+    enum profile_e type;
+    const struct file_s *file;
+    line_t line;
+    proftime_t time;
+    size_t lines;
+    size_t calls;
+    struct avltree_node node;
+};
+
+struct profile_line_s {
+    const struct file_list_s *flist;
+    line_t line;
+    size_t count;
+    proftime_t time;
+    struct avltree_node node;
+};
+
+static struct avltree profile_tree;
+static struct profile_s *lastpr = NULL;
+static struct avltree line_tree;
+static struct profile_line_s *lastpl = NULL;
+static struct profile_line_s *profile_line_last;
+
+static struct frame_s {
+    struct profile_s *entry;
+    struct profile_line_s *line;
+} *stack = NULL;
+static size_t stack_len, stack_p;
+
+static struct trace_s {
+    enum trace_e type;
+    uint8_t pass;
+    const struct file_list_s *flist;
+    struct linepos_s epoint;
+    uint8_t *name;
+    uint8_t *oldval, *newval;
+} *traces = NULL;
+static size_t traces_len, traces_p;
+
+static struct pass_s {
+    uint8_t pass;
+    bool listing;
+    proftime_t time;
+    size_t lines;
+} *passes = NULL;
+static size_t passes_len, passes_p;
+
+struct memstats_s {
+    struct values_stats_s values;
+    size_t files;
+    size_t output;
+    size_t errors;
+};
+
+static struct mempass_s {
+    uint8_t pass;
+    bool listing;
+    struct memstats_s mem;
+} *mempasses = NULL;
+static size_t mempasses_len, mempasses_p;
+
+static proftime_t lasttime;
+static size_t lastlines;
+
+static int profile_compare(const struct avltree_node *aa, const struct avltree_node *bb)
+{
+    const struct profile_s *a = cavltree_container_of(aa, struct profile_s, node);
+    const struct profile_s *b = cavltree_container_of(bb, struct profile_s, node);
+
+    if (a->type != b->type) return a->type - b->type;
+    if (a->file != b->file) return (a->file > b->file) ? 1 : -1;
+    if (a->line != b->line) return (a->line > b->line) ? 1 : -1;
+    return 0;
+}
+
+static void profile_free(struct avltree_node *aa)
+{
+    struct profile_s *a = avltree_container_of(aa, struct profile_s, node);
+
+    free(a);
+}
+
+static int line_compare(const struct avltree_node *aa, const struct avltree_node *bb)
+{
+    const struct profile_line_s *a = cavltree_container_of(aa, struct profile_line_s, node);
+    const struct profile_line_s *b = cavltree_container_of(bb, struct profile_line_s, node);
+
+    if (a->flist != b->flist) return (a->flist > b->flist) ? 1 : -1;
+    if (a->line != b->line) return (a->line > b->line) ? 1 : -1;
+    return 0;
+}
+
+static void line_free(struct avltree_node *aa)
+{
+    struct profile_line_s *a = avltree_container_of(aa, struct profile_line_s, node);
+
+    free(a);
+}
+
+/* Wall time in nanoseconds, so waiting for file reads is counted too.
+   Processor time is used where there's no monotonic clock. */
+proftime_t profile_time(void) {
+#ifdef PROFILE_MONOTONIC
+    struct timespec ts;
+    if (clock_gettime(CLOCK_MONOTONIC, &ts) != 0) return 0;
+    return (proftime_t)ts.tv_sec * 1000000000 + (proftime_t)ts.tv_nsec;
+#else
+    clock_t t = clock();
+    return (proftime_t)(t / CLOCKS_PER_SEC) * 1000000000 + (proftime_t)(t % CLOCKS_PER_SEC) * 1000000000 / CLOCKS_PER_SEC;
+#endif
+}
+
+/* Charge the time and lines since the last event to the innermost entry */
+static void charge(void) {
+    proftime_t now = profile_time();
+    if (stack_p != 0 && stack[stack_p - 1].entry != NULL) {
+        struct profile_s *p = stack[stack_p - 1].entry;
+        p->time += now - lasttime;
+        p->lines += profile_lines - lastlines;
+    }
+    lasttime = now;
+    lastlines = profile_lines;
+}
+
+void profile_enter(enum profile_e type, const struct file_s *file, line_t line) {
+    struct avltree_node *b;
+    struct profile_s *p = NULL;
+    if (!arguments.timereport && arguments.profile == NULL && arguments.profilestacks == NULL) return;
+    if (arguments.timereport) {
+        charge();
+        if (lastpr == NULL) lastpr = (struct profile_s *)mallocx(sizeof *lastpr);
+        lastpr->type = type;
+        lastpr->file = file;
+        lastpr->line = line;
+        b = avltree_insert(&lastpr->node, &profile_tree, profile_compare);
+        if (b == NULL) {
+            p = lastpr;
+            p->time = 0;
+            p->lines = 0;
+            p->calls = 0;
+            lastpr = NULL;
+        } else p = avltree_container_of(b, struct profile_s, node);
+        p->calls++;
+    }
+    if (stack_p >= stack_len) {
+        stack_len += 16;
+        if (/*stack_len < 16 ||*/ stack_len > SIZE_MAX / sizeof *stack) err_msg_out_of_memory(); /* overflow */
+        stack = (struct frame_s *)reallocx(stack, stack_len * sizeof *stack);
+    }
+    stack[stack_p].entry = p;
+    stack[stack_p].line = profile_line_last;
+    stack_p++;
+}
+
+void profile_exit(void) {
+    if (stack_p == 0) return;
+    if (arguments.timereport) charge();
+    stack_p--;
+    profile_line_last = stack[stack_p].line;
+}
+
+/* Count a source line processed, the key is the file list node as it
+   identifies the chain of includes and macro calls leading here */
+void profile_line(const struct file_list_s *flist, line_t line) {
+    struct avltree_node *b;
+    if (lastpl == NULL) lastpl = (struct profile_line_s *)mallocx(sizeof *lastpl);
+    lastpl->flist = flist;
+    lastpl->line = line;
+    b = avltree_insert(&lastpl->node, &line_tree, line_compare);
+    if (b == NULL) {
+        profile_line_last = lastpl;
+        lastpl->count = 0;
+        lastpl->time = 0;
+        lastpl = NULL;
+    } else profile_line_last = avltree_container_of(b, struct profile_line_s, node);
+    profile_line_last->count++;
+}
+
+/* Line expressions are evaluated on, NULL if lines are not profiled */
+struct profile_line_s *profile_line_current(void) {
+    return profile_line_last;
+}
+
+/* Time of expression evaluation started on a line */
+void profile_expr(struct profile_line_s *pl, proftime_t start) {
+    if (pl != NULL) pl->time += profile_time() - start;
+}
+
+void profile_pass_begin(void) {
+    if (!arguments.timereport) return;
+    charge();
+    if (passes_p >= passes_len) {
+        passes_len += 16;
+        if (/*passes_len < 16 ||*/ passes_len > SIZE_MAX / sizeof *passes) err_msg_out_of_memory(); /* overflow */
+        passes = (struct pass_s *)reallocx(passes, passes_len * sizeof *passes);
+    }
+    passes[passes_p].time = lasttime;
+    passes[passes_p].lines = lastlines;
+}
+
+static void memstats_get(struct memstats_s *m) {
+    values_memstats(&m->values);
+    m->files = file_memory();
+    m->output = section_memory();
+    m->errors = error_memory();
+}
+
+static void memstats_pass_end(uint8_t passno, bool listing) {
+    struct mempass_s *p;
+    if (mempasses_p >= mempasses_len) {
+        mempasses_len += 16;
+        if (/*mempasses_len < 16 ||*/ mempasses_len > SIZE_MAX / sizeof *mempasses) err_msg_out_of_memory(); /* overflow */
+        mempasses = (struct mempass_s *)reallocx(mempasses, mempasses_len * sizeof *mempasses);
+    }
+    p = &mempasses[mempasses_p++];
+    p->pass = passno;
+    p->listing = listing;
+    memstats_get(&p->mem);
+}
+
+void profile_pass_end(uint8_t passno, bool listing) {
+    struct pass_s *p;
+    if (arguments.memstats) memstats_pass_end(passno, listing);
+    if (!arguments.timereport || passes_p >= passes_len) return;
+    charge();
+    p = &passes[passes_p++];
+    p->pass = passno;
+    p->listing = listing;
+    p->time = lasttime - p->time;
+    p->lines = lastlines - p->lines;
+}
+
+static int cost_compare(const void *aa, const void *bb) {
+    const struct profile_s *a = *(const struct profile_s * const *)aa;
+    const struct profile_s *b = *(const struct profile_s * const *)bb;
+    if (a->time != b->time) return (a->time < b->time) ? 1 : -1;
+    if (a->lines != b->lines) return (a->lines < b->lines) ? 1 : -1;
+    return 0;
+}
+
+static double seconds(proftime_t t) {
+    return (double)t / 1000000000.0;
+}
+
+/* Macros are named after the label on their definition line */
+static void print_name(const struct profile_s *p, FILE *f) {
+    static const char *types[3] = {"file", "macro", "function"};
+    const struct file_s *file = p->file;
+    fputs(types[p->type], f);
+    if (p->type != PROFILE_FILE && p->line != 0 && p->line <= file->lines) {
+        const uint8_t *s = file->data + file->line[p->line - 1];
+        size_t i = 0;
+        while (s[i] == '_' || (s[i] >= 'a' && s[i] <= 'z') || (s[i] >= 'A' && s[i] <= 'Z') || (s[i] >= '0' && s[i] <= '9' && i != 0)) i++;
+        if (i != 0) {
+            putc(' ', f);
+            fwrite(s, 1, i, f);
+        }
+    }
+    putc(' ', f);
+    argv_print(file->realname, f);
+    if (p->type != PROFILE_FILE) fprintf(f, ":%" PRIuline, p->line);
+    putc('\n', f);
+}
+
+void profile_print(FILE *f) {
+    const struct avltree_node *n;
+    struct profile_s **list;
+    size_t i, len = 0;
+    proftime_t total = 0;
+
+    if (!arguments.timereport) return;
+    charge();
+    fputs("Time report:\n", f);
+    for (i = 0; i < passes_p; i++) {
+        const struct pass_s *p = &passes[i];
+        total += p->time;
+        if (p->listing) fputs("Listing pass:      ", f);
+        else fprintf(f, "Pass %-3u           ", (unsigned int)p->pass);
+        fprintf(f, "%8.3f s %10" PRIuSIZE " lines\n", seconds(p->time), p->lines);
+    }
+    for (n = avltree_first(&profile_tree); n != NULL; n = avltree_next(n)) len++;
+    if (len == 0) return;
+    list = (struct profile_s **)mallocx(len * sizeof *list);
+    len = 0;
+    for (n = avltree_first(&profile_tree); n != NULL; n = avltree_next(n)) {
+        list[len++] = avltree_container_of((struct avltree_node *)n, struct profile_s, node);
+    }
+    qsort(list, len, sizeof *list, cost_compare);
+    fputs("Top files and macros by own time:\n", f);
+    for (i = 0; i < len && i < PROFILE_TOP; i++) {
+        const struct profile_s *p = list[i];
+        fprintf(f, "%8.3f s %5.1f%% %10" PRIuSIZE " lines %8" PRIuSIZE " calls  ", seconds(p->time), (total != 0) ? p->time * 100.0 / total : 0.0, p->lines, p->calls);
+        print_name(p, f);
+    }
+    free(list);
+}
+
+static void memstats_line(const struct memstats_s *m, FILE *f) {
+    fprintf(f, "%11" PRIuSIZE " %11" PRIuSIZE " %11" PRIuSIZE " %11" PRIuSIZE " %11" PRIuSIZE " %9" PRIuSIZE "\n", m->values.slots, m->values.blocks, m->values.payload, m->files, m->output, m->errors);
+}
+
+static void memstats_max(struct memstats_s *m, const struct memstats_s *m2) {
+    if (m2->values.slots > m->values.slots) m->values.slots = m2->values.slots;
+    if (m2->values.blocks > m->values.blocks) m->values.blocks = m2->values.blocks;
+    if (m2->values.payload > m->values.payload) m->values.payload = m2->values.payload;
+    if (m2->files > m->files) m->files = m2->files;
+    if (m2->output > m->output) m->output = m2->output;
+    if (m2->errors > m->errors) m->errors = m2->errors;
+}
+
+/* Byte counts at the end of each pass, their peak and at exit */
+void memstats_print(FILE *f) {
+    struct memstats_s m, peak;
+    size_t i;
+
+    if (!arguments.memstats) return;
+    memstats_get(&m);
+    peak = m;
+    fputs("Memory report:\n"
+          "                  values slot blocks     payload     sources      output    errors\n", f);
+    for (i = 0; i < mempasses_p; i++) {
+        const struct mempass_s *p = &mempasses[i];
+        if (p->listing) fputs("Listing pass:", f);
+        else fprintf(f, "Pass %-3u     ", (unsigned int)p->pass);
+        memstats_line(&p->mem, f);
+        memstats_max(&peak, &p->mem);
+    }
+    fputs("At exit:     ", f);
+    memstats_line(&m, f);
+    fputs("Peak:        ", f);
+    memstats_line(&peak, f);
+    values_memstats_print(f);
+}
+
+static int report_compare(const void *aa, const void *bb) {
+    const struct profile_line_s *a = *(const struct profile_line_s * const *)aa;
+    const struct profile_line_s *b = *(const struct profile_line_s * const *)bb;
+    if (a->flist->file != b->flist->file) return (a->flist->file > b->flist->file) ? 1 : -1;
+    if (a->line != b->line) return (a->line > b->line) ? 1 : -1;
+    return 0;
+}
+
+static int hot_compare(const void *aa, const void *bb) {
+    const struct profile_line_s *a = *(const struct profile_line_s * const *)aa;
+    const struct profile_line_s *b = *(const struct profile_line_s * const *)bb;
+    if (a->time != b->time) return (a->time < b->time) ? 1 : -1;
+    if (a->count != b->count) return (a->count < b->count) ? 1 : -1;
+    return report_compare(aa, bb);
+}
+
+static void print_line(const struct file_s *file, line_t line, FILE *f) {
+    argv_print(file->realname, f);
+    fprintf(f, ":%" PRIuline, line);
+}
+
+/* Lines sorted by expression evaluation time and count, summed over
+   all the places they were reached from */
+static void profile_report(const char *name) {
+    static const struct linepos_s nopoint = {0, 0};
+    const struct avltree_node *n;
+    struct profile_line_s **list;
+    size_t i, j, len = 0;
+    FILE *f;
+
+    for (n = avltree_first(&line_tree); n != NULL; n = avltree_next(n)) len++;
+    if (len > SIZE_MAX / sizeof *list) err_msg_out_of_memory(); /* overflow */
+    list = (struct profile_line_s **)mallocx((len + 1) * sizeof *list);
+    len = 0;
+    for (n = avltree_first(&line_tree); n != NULL; n = avltree_next(n)) {
+        list[len++] = avltree_container_of((struct avltree_node *)n, struct profile_line_s, node);
+    }
+    qsort(list, len, sizeof *list, report_compare);
+    for (i = j = 0; i < len; i++) {
+        if (j != 0 && report_compare(&list[j - 1], &list[i]) == 0) {
+            list[j - 1]->count += list[i]->count;
+            list[j - 1]->time += list[i]->time;
+            list[i]->count = 0;
+            continue;
+        }
+        list[j++] = list[i];
+    }
+    len = j;
+    qsort(list, len, sizeof *list, hot_compare);
+
+    f = dash_name(name) ? stdout : file_open(name, "wt");
+    if (f == NULL) {
+        err_msg_file(ERROR_CANT_WRTE_PRF, name, &nopoint);
+        free(list);
+        return;
+    }
+    fputs(";     count  expr time  line\n", f);
+    for (i = 0; i < len; i++) {
+        const struct profile_line_s *p = list[i];
+        const struct file_s *file = p->flist->file;
+        fprintf(f, "%11" PRIuSIZE " %10.6f  ", p->count, seconds(p->time));
+        print_line(file, p->line, f);
+        if (p->line != 0 && p->line <= file->lines) {
+            const uint8_t *s = file->data + file->line[p->line - 1];
+            putc('\t', f);
+            while (*s == ' ' || *s == '\t') s++;
+            printable_print(s, f);
+        }
+        putc('\n', f);
+    }
+    if (f != stdout) fclose(f); else fflush(f);
+    free(list);
+}
+
+static void print_stack(const struct file_list_s *flist, line_t line, FILE *f) {
+    if (flist->parent != NULL && flist->parent->file != NULL) {
+        print_stack(flist->parent, flist->epoint.line, f);
+        putc(';', f);
+    }
+    print_line(flist->file, line, f);
+}
+
+/* Collapsed stacks for flame graph tools, weighted by line count */
+static void profile_stacks(const char *name) {
+    static const struct linepos_s nopoint = {0, 0};
+    const struct avltree_node *n;
+    FILE *f = dash_name(name) ? stdout : file_open(name, "wt");
+    if (f == NULL) {
+        err_msg_file(ERROR_CANT_WRTE_PRF, name, &nopoint);
+        return;
+    }
+    for (n = avltree_first(&line_tree); n != NULL; n = avltree_next(n)) {
+        const struct profile_line_s *p = cavltree_container_of(n, struct profile_line_s, node);
+        if (p->count == 0) continue;
+        print_stack(p->flist, p->line, f);
+        fprintf(f, " %" PRIuSIZE "\n", p->count);
+    }
+    if (f != stdout) fclose(f); else fflush(f);
+}
+
+void profile_write(void) {
+    if (arguments.profilestacks != NULL) profile_stacks(arguments.profilestacks);
+    if (arguments.profile != NULL) profile_report(arguments.profile);
+}
+
+static uint8_t *trace_copy(const uint8_t *data, size_t len) {
+    uint8_t *s;
+    if (len >= SIZE_MAX) err_msg_out_of_memory(); /* overflow */
+    s = (uint8_t *)mallocx(len + 1);
+    memcpy(s, data, len);
+    s[len] = 0;
+    return s;
+}
+
+static uint8_t *trace_repr(Obj *val, linepos_t epoint) {
+    Obj *str;
+    uint8_t *s;
+    if (val == NULL) return NULL;
+    str = val->obj->repr(val, epoint, 40);
+    if (str == NULL) return trace_copy((const uint8_t *)"...", 3);
+    if (str->obj == STR_OBJ) s = trace_copy(((Str *)str)->data, ((Str *)str)->len);
+    else s = trace_copy((const uint8_t *)"?", 1);
+    val_destroy(str);
+    return s;
+}
+
+static struct trace_s *trace_new(enum trace_e type, const str_t *name, const struct file_list_s *flist, linepos_t epoint) {
+    struct trace_s *t;
+    if (traces_p >= traces_len) {
+        traces_len += 64;
+        if (/*traces_len < 64 ||*/ traces_len > SIZE_MAX / sizeof *traces) err_msg_out_of_memory(); /* overflow */
+        traces = (struct trace_s *)reallocx(traces, traces_len * sizeof *traces);
+    }
+    t = &traces[traces_p++];
+    t->type = type;
+    t->pass = pass;
+    t->flist = flist;
+    t->epoint = *epoint;
+    t->name = (name != NULL) ? trace_copy(name->data, name->len) : NULL;
+    t->oldval = t->newval = NULL;
+    return t;
+}
+
+/* Record something which changed since the previous pass and so
+   requires another one, values are optional */
+void trace_change(enum trace_e type, const str_t *name, linepos_t epoint, Obj *oldval, Obj *newval) {
+    struct trace_s *t;
+    if (!arguments.tracepasses) return;
+    t = trace_new(type, name, get_file_list(), epoint);
+    t->oldval = trace_repr(oldval, epoint);
+    t->newval = trace_repr(newval, epoint);
+}
+
+void trace_address(enum trace_e type, const str_t *name, linepos_t epoint, address_t oldaddr, address_t newaddr) {
+    struct trace_s *t;
+    char temp[16];
+    if (!arguments.tracepasses) return;
+    t = trace_new(type, name, get_file_list(), epoint);
+    t->oldval = trace_copy((uint8_t *)temp, (size_t)sprintf(temp, "$%04" PRIaddress, oldaddr));
+    t->newval = trace_copy((uint8_t *)temp, (size_t)sprintf(temp, "$%04" PRIaddress, newaddr));
+}
+
+/* Same for a label, which might be defined in a different file */
+void trace_label(enum trace_e type, const Label *label, Obj *oldval, Obj *newval) {
+    struct trace_s *t;
+    if (!arguments.tracepasses) return;
+    t = trace_new(type, &label->name, label->file_list, &label->epoint);
+    t->oldval = trace_repr(oldval, &label->epoint);
+    t->newval = trace_repr(newval, &label->epoint);
+}
+
+void trace_label_address(enum trace_e type, const Label *label, address_t oldaddr, address_t newaddr) {
+    struct trace_s *t;
+    char temp[16];
+    if (!arguments.tracepasses) return;
+    t = trace_new(type, &label->name, label->file_list, &label->epoint);
+    t->oldval = trace_copy((uint8_t *)temp, (size_t)sprintf(temp, "$%04" PRIaddress, oldaddr));
+    t->newval = trace_copy((uint8_t *)temp, (size_t)sprintf(temp, "$%04" PRIaddress, newaddr));
+}
+
+static void trace_name(const char *what, const uint8_t *name, FILE *f) {
+    fputs(what, f);
+    if (name == NULL) return;
+    fputs(" '", f);
+    printable_print(name, f);
+    putc('\'', f);
+}
+
+void trace_print(FILE *f) {
+    size_t i;
+    uint8_t lastpass = 0;
+
+    if (!arguments.tracepasses) return;
+    for (i = 0; i < traces_p; i++) {
+        const struct trace_s *t = &traces[i];
+        if (i == 0 || t->pass != lastpass) {
+            size_t j;
+            for (j = i; j < traces_p && traces[j].pass == t->pass; j++);
+            lastpass = t->pass;
+            fprintf(f, "Pass %-3u changes:  %" PRIuSIZE "\n", (unsigned int)lastpass, j - i);
+        }
+        fputs("  ", f);
+        if (t->flist != NULL && t->flist->file != NULL) {
+            print_line(t->flist->file, t->epoint.line, f);
+            fputs(": ", f);
+        }
+        switch (t->type) {
+        case TRACE_VALUE: trace_name("value of", t->name, f); break;
+        case TRACE_ADDRESS: trace_name("address of", t->name, f); break;
+        case TRACE_SIZE: trace_name("size of", t->name, f); break;
+        case TRACE_STAR: fputs("program counter", f); break;
+        case TRACE_SECTION: trace_name("section", t->name, f); break;
+        case TRACE_REQUIRES: trace_name("requirements of", t->name, f); break;
+        case TRACE_NEW: trace_name("symbol", t->name, f); fputs(" defined after it was looked up", f); break;
+        case TRACE_PROC: trace_name("procedure", t->name, f); fputs(" compiled before its use is known", f); break;
+        case TRACE_REGISTERS: fputs("register names of the cpu created", f); break;
+        }
+        if (t->oldval != NULL && t->newval != NULL) {
+            fputs(" changed from ", f);
+            printable_print(t->oldval, f);
+            fputs(" to ", f);
+            printable_print(t->newval, f);
+        } else if (t->type == TRACE_SECTION) fputs(" not defined yet", f);
+        putc('\n', f);
+    }
+}
+
+void init_profile(void) {
+    avltree_init(&profile_tree);
+    avltree_init(&line_tree);
+    profile_line_last = NULL;
+    profile_lines = 0;
+    lasttime = profile_time();
+    lastlines = 0;
+    stack_p = 0;
+    passes_p = 0;
+    traces_p = 0;
+}
+
+void destroy_profile(void) {
+    avltree_destroy(&profile_tree, profile_free);
+    free(lastpr);
+    lastpr = NULL;
+    avltree_destroy(&line_tree, line_free);
+    free(lastpl);
+    lastpl = NULL;
+    while (traces_p != 0) {
+        struct trace_s *t = &traces[--traces_p];
+        free(t->name);
+        free(t->oldval);
+        free(t->newval);
+    }
+    free(traces);
+    traces = NULL;
+    traces_len = 0;
+    free(stack);
+    stack = NULL;
+    stack_len = stack_p = 0;
+    free(passes);
+    passes = NULL;
+    passes_len = passes_p = 0;
+    free(mempasses);
+    mempasses = NULL;
+    mempasses_len = mempasses_p = 0;
+}
@@ -0,0 +1,64 @@
+/*
+    $Id$
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+*/
+#ifndef PROFILE_H
+#define PROFILE_H
+#include <stdio.h>
+#include <time.h>
+#include "stdbool.h"
+#include "inttypes.h"
+
+typedef uint64_t proftime_t;
+
+enum profile_e {
+    PROFILE_FILE, PROFILE_MACRO, PROFILE_FUNCTION
+};
+
+enum trace_e {
+    TRACE_VALUE, TRACE_ADDRESS, TRACE_SIZE, TRACE_STAR, TRACE_SECTION,
+    TRACE_REQUIRES, TRACE_NEW, TRACE_PROC, TRACE_REGISTERS
+};
+
+struct file_s;
+struct file_list_s;
+struct profile_line_s;
+struct Obj;
+struct Label;
+
+extern size_t profile_lines;
+
+extern void profile_enter(enum profile_e, const struct file_s *, line_t);
+extern void profile_exit(void);
+extern void profile_pass_begin(void);
+extern void profile_pass_end(uint8_t, bool);
+extern void profile_print(FILE *);
+extern void memstats_print(FILE *);
+extern void profile_line(const struct file_list_s *, line_t);
+extern proftime_t profile_time(void);
+extern struct profile_line_s *profile_line_current(void);
+extern void profile_expr(struct profile_line_s *, proftime_t);
+extern void profile_write(void);
+extern void trace_change(enum trace_e, const str_t *, linepos_t, struct Obj *, struct Obj *);
+extern void trace_address(enum trace_e, const str_t *, linepos_t, address_t, address_t);
+extern void trace_label(enum trace_e, const struct Label *, struct Obj *, struct Obj *);
+extern void trace_label_address(enum trace_e, const struct Label *, address_t, address_t);
+extern void trace_print(FILE *);
+extern void init_profile(void);
+extern void destroy_profile(void);
+
+#endif
@@ -166,6 +166,16 @@ void destroy_section(void) {
     destroy_section2(&root_section);
 }
 
+/* Bytes of output held by all sections */
+size_t section_memory(void) {
+    const struct section_s *l;
+    size_t sum = memblocks_memory(&root_section.mem);
+    for (l = root_section.next; l != NULL; l = l->next) {
+        sum += memblocks_memory(&l->mem);
+    }
+    return sum;
+}
+
 static void sectionprint2(const struct section_s *l) {
     if (l->name.data != NULL) {
         sectionprint2(l->parent);
@@ -23,6 +23,8 @@
 #include "unicode.h"
 #include "error.h"
 #include "strobj.h"
+#include "bytesobj.h"
+#include "listobj.h"
 #include "typeobj.h"
 #include "noneobj.h"
 #include "variables.h"
@@ -39,13 +41,27 @@ static Slot *values_free[32];
 
 typedef struct Slotcoll {
     struct Slotcoll *next;
+    size_t used;
 } Slotcoll;
 
 static Slotcoll *slotcoll[32];
 
+/* The cycle collector runs between passes, but only once enough new
+   containers were allocated since the last run to make it worthwhile. */
+#define GC_MIN 4096
+static size_t gc_allocated;
+static size_t gc_threshold = GC_MIN;
+static bool gc_class[32];
+
+/* Values in use by type, for --mem-stats */
+static size_t type_live[T_NAMESPACE + 1];
+static size_t type_peak[T_NAMESPACE + 1];
+static const Type *type_seen[T_NAMESPACE + 1];
+
 static inline void value_free(Obj *val) {
     size_t p = (val->obj->length + (ALIGN - 1)) / ALIGN;
     Slot *slot = (Slot *)val, **c = &values_free[p];
+    type_live[val->obj->type]--;
     slot->next = *c;
     val->obj = NONE_OBJ;
     *c = slot;
@@ -56,24 +72,27 @@ Obj *val_alloc(Type *obj) {
     Slot **c = &values_free[p];
     Obj *val = (Obj *)*c;
     if (val == NULL) {
-        size_t i, size = p * ALIGN;
-        Slot *slot;
-        Slotcoll **s = &slotcoll[p];
-        Slotcoll *n = (Slotcoll *)mallocx(size * SLOTS + sizeof *n);
-        n->next = *s; *s = n;
-        slot = (Slot *)(n + 1);
-        val = (Obj *)slot;
-        for (i = 0; i < (SLOTS - 1); i++, slot = (Slot *)(((const char *)slot) + size)) {
-            slot->v.obj = NONE_OBJ;
-            slot->v.refcount = 1;
-            slot->next = (Slot *)(((const char *)slot) + size);
+        size_t size = p * ALIGN;
+        Slotcoll *n = slotcoll[p];
+        if (n == NULL || n->used == SLOTS) {
+            n = (Slotcoll *)mallocx(size * SLOTS + sizeof *n);
+            n->next = slotcoll[p];
+            n->used = 0;
+            slotcoll[p] = n;
         }
-        slot->v.obj = NONE_OBJ;
-        slot->v.refcount = 1;
-        slot->next = NULL;
-    }
-    *c = ((Slot *)val)->next;
+        val = (Obj *)(((char *)(n + 1)) + size * n->used);
+        n->used++;
+        val->refcount = 1;
+    } else *c = ((Slot *)val)->next;
     val->obj = obj;
+    if (obj->garbage != NULL) {
+        gc_allocated++;
+        gc_class[p] = true;
+    }
+    if (++type_live[obj->type] > type_peak[obj->type]) {
+        type_peak[obj->type] = type_live[obj->type];
+        type_seen[obj->type] = obj;
+    }
     return val;
 }
 
@@ -83,17 +102,19 @@ static inline void obj_destroy(Obj *v1) {
 
 void garbage_collect(void) {
     Slotcoll *vals;
-    size_t i, j;
+    size_t i, j, live = 0;
     destroy_lastlb();
 
     for (j = 0; j < lenof(slotcoll); j++) {
         size_t size = j * ALIGN;
+        if (!gc_class[j]) continue;
         for (vals = slotcoll[j]; vals != NULL; vals = vals->next) {
             Obj *val = (Obj *)(vals + 1);
-            for (i = 0; i < SLOTS; i++, val = (Obj *)(((const char *)val) + size)) {
+            for (i = 0; i < vals->used; i++, val = (Obj *)(((const char *)val) + size)) {
                 if (val->obj->garbage != NULL) {
                     val->obj->garbage(val, -1);
                     val->refcount |= SIZE_MSB;
+                    live++;
                 }
             }
         }
@@ -101,9 +122,10 @@ void garbage_collect(void) {
 
     for (j = 0; j < lenof(slotcoll); j++) {
         size_t size = j * ALIGN;
+        if (!gc_class[j]) continue;
         for (vals = slotcoll[j]; vals != NULL; vals = vals->next) {
             Obj *val = (Obj *)(vals + 1);
-            for (i = 0; i < SLOTS; i++, val = (Obj *)(((const char *)val) + size)) {
+            for (i = 0; i < vals->used; i++, val = (Obj *)(((const char *)val) + size)) {
                 if (val->obj->garbage != NULL) {
                     if (val->refcount > SIZE_MSB) {
                         val->refcount -= SIZE_MSB;
@@ -118,16 +140,26 @@ void garbage_collect(void) {
         size_t size = j * ALIGN;
         for (vals = slotcoll[j]; vals != NULL; vals = vals->next) {
             Obj *val = (Obj *)(vals + 1);
-            for (i = 0; i < SLOTS; i++, val = (Obj *)(((const char *)val) + size)) {
+            for (i = 0; i < vals->used; i++, val = (Obj *)(((const char *)val) + size)) {
                 if ((val->refcount & ~SIZE_MSB) == 0) {
                     val->refcount = 1;
-                    if (val->obj->garbage != NULL) val->obj->garbage(val, 0);
-                    else obj_destroy(val);
+                    if (val->obj->garbage != NULL) {
+                        val->obj->garbage(val, 0);
+                        live--;
+                    } else obj_destroy(val);
                     value_free(val);
                 }
             }
         }
     }
+
+    gc_allocated = 0;
+    gc_threshold = (live > GC_MIN) ? live : GC_MIN;
+}
+
+void garbage_collect_pass(void) {
+    if (gc_allocated < gc_threshold) return;
+    garbage_collect();
 }
 
 void val_destroy(Obj *val) {
@@ -163,6 +195,73 @@ int val_print(Obj *v1, FILE *f) {
     return len;
 }
 
+/* Bytes held outside of the slot by strings, bytes and lists */
+static size_t payload(const Obj *val) {
+    switch (val->obj->type) {
+    case T_STR:
+        {
+            const Str *v = (const Str *)val;
+            return (v->data != v->val) ? v->len : 0;
+        }
+    case T_BYTES:
+        {
+            const Bytes *v = (const Bytes *)val;
+            return (v->data != v->val) ? (size_t)(v->len < 0 ? ~v->len : v->len) : 0;
+        }
+    case T_LIST:
+    case T_TUPLE:
+    case T_ADDRLIST:
+    case T_COLONLIST:
+        {
+            const List *v = (const List *)val;
+            return (v->data != v->val) ? v->len * sizeof *v->data : 0;
+        }
+    default:
+        return 0;
+    }
+}
+
+void values_memstats(struct values_stats_s *st) {
+    const Slotcoll *vals;
+    size_t i, j;
+    st->slots = st->blocks = st->payload = 0;
+    for (j = 0; j < lenof(slotcoll); j++) {
+        size_t size = j * ALIGN;
+        for (vals = slotcoll[j]; vals != NULL; vals = vals->next) {
+            const Obj *val = (const Obj *)(vals + 1);
+            st->blocks += size * SLOTS + sizeof *vals;
+            for (i = 0; i < vals->used; i++, val = (const Obj *)(((const char *)val) + size)) {
+                if (val->obj == NONE_OBJ) continue;
+                st->slots += size;
+                st->payload += payload(val);
+            }
+        }
+    }
+}
+
+void values_memstats_print(FILE *f) {
+    size_t i, j;
+    fputs("Values by type:         in use       peak   slot size\n", f);
+    for (i = 0; i < lenof(type_peak); i++) {
+        if (type_seen[i] == NULL) continue;
+        j = (type_seen[i]->length + (ALIGN - 1)) / ALIGN;
+        fprintf(f, "%-16s %13" PRIuSIZE " %10" PRIuSIZE " %11" PRIuSIZE "\n", type_seen[i]->name, type_live[i], type_peak[i], j * ALIGN);
+    }
+    fputs("Slot size classes:      blocks       used  free list\n", f);
+    for (j = 0; j < lenof(slotcoll); j++) {
+        const Slotcoll *vals;
+        const Slot *slot;
+        size_t blocks = 0, used = 0, free_len = 0;
+        for (vals = slotcoll[j]; vals != NULL; vals = vals->next) {
+            blocks++;
+            used += vals->used;
+        }
+        if (blocks == 0) continue;
+        for (slot = values_free[j]; slot != NULL; slot = slot->next) free_len++;
+        fprintf(f, "%5" PRIuSIZE " bytes %18" PRIuSIZE " %10" PRIuSIZE " %10" PRIuSIZE "\n", j * ALIGN, blocks, used - free_len, free_len);
+    }
+}
+
 void init_values(void)
 {
 }
@@ -181,7 +280,7 @@ void destroy_values(void)
         size_t size = j * ALIGN;
         for (vals = slotcoll[j]; vals; vals = vals->next) {
             Obj *val = (Obj *)(vals + 1);
-            for (i = 0; i < SLOTS; i++, val = ((void *)val) + size) {
+            for (i = 0; i < vals->used; i++, val = ((void *)val) + size) {
                 if (val->obj != NONE_OBJ) {
                     val_print(val, stderr);
                     fprintf(stderr, " %s %" PRIuSIZE " %" PRIxPTR "\n", val->obj->name, val->refcount, (uintptr_t)val);
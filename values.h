@@ -29,7 +29,16 @@ extern void val_destroy(struct Obj *);
 extern void val_replace(struct Obj **, struct Obj *);
 extern int val_print(struct Obj *, FILE *);
 
+struct values_stats_s {
+    size_t slots;     /* bytes of values in use */
+    size_t blocks;    /* bytes of slot blocks */
+    size_t payload;   /* bytes of string, bytes and list data */
+};
+
+extern void values_memstats(struct values_stats_s *);
+extern void values_memstats_print(FILE *);
 extern void destroy_values(void);
 extern void init_values(void);
 extern void garbage_collect(void);
+extern void garbage_collect_pass(void);
 #endif
@@ -38,13 +38,13 @@
 #include "bitsobj.h"
 #include "dictobj.h"
 #include "addressobj.h"
+#include "opcodes.h"
 #include "gapobj.h"
 #include "typeobj.h"
 #include "noneobj.h"
 #include "values.h"
 #include "arguments.h"
 
-static struct namespacekey_s *lastlb2 = NULL;
 static Label *lastlb = NULL;
 
 static Type obj;
@@ -58,6 +58,11 @@ static Namespace *builtin_namespace;
 Namespace *current_context;
 Namespace *cheap_context;
 
+/* Incremented on every change which may alter the result of a label lookup,
+   like a label getting defined or a change of the context stack. Cached
+   lookups of identifiers are only reused while it stays the same. */
+unsigned int label_generation;
+
 static MUST_CHECK Obj *create(Obj *v1, linepos_t epoint) {
     switch (v1->obj->type) {
     case T_NONE:
@@ -71,8 +76,7 @@ static MUST_CHECK Obj *create(Obj *v1, linepos_t epoint) {
 
 static void destroy(Obj *o1) {
     Label *v1 = (Label *)o1;
-    free((char *)v1->name.data);
-    if (v1->name.data != v1->cfname.data) free((uint8_t *)v1->cfname.data);
+    label_generation++;
     val_destroy(v1->value);
 }
 
@@ -84,8 +88,7 @@ static void garbage(Obj *o1, int i) {
         v1->value->refcount--;
         return;
     case 0:
-        free((char *)v1->name.data);
-        if (v1->name.data != v1->cfname.data) free((uint8_t *)v1->cfname.data);
+        label_generation++;
         return;
     case 1:
         v = v1->value;
@@ -161,6 +164,7 @@ void push_context(Namespace *name) {
         context_stack.stack = (struct cstack_s *)reallocx(context_stack.stack, context_stack.len * sizeof *context_stack.stack);
     }
     context_stack.stack[context_stack.p].normal = ref_namespace(name);
+    label_generation++;
     current_context = name;
     context_stack.stack[context_stack.p].cheap = cheap_context;
     cheap_context = ref_namespace(name);
@@ -170,6 +174,7 @@ void push_context(Namespace *name) {
 bool pop_context(void) {
     if (context_stack.p > 1 + context_stack.bottom) {
         struct cstack_s *c = &context_stack.stack[--context_stack.p];
+        label_generation++;
         val_destroy(&c->normal->v);
         val_destroy(&cheap_context->v); 
         cheap_context = c->cheap;
@@ -224,101 +229,255 @@ void get_namespaces(Mfunc *mfunc) {
 }
 
 void context_set_bottom(size_t n) {
+    label_generation++;
     context_stack.bottom = n;
 }
 
 size_t context_get_bottom(void) {
     size_t old = context_stack.bottom;
+    label_generation++;
     context_stack.bottom = context_stack.p;
     return old;
 }
 
 /* --------------------------------------------------------------------------- */
 
-static int label_compare(const struct avltree_node *aa, const struct avltree_node *bb)
-{
-    const struct namespacekey_s *a = cavltree_container_of(aa, struct namespacekey_s, node);
-    const struct namespacekey_s *b = cavltree_container_of(bb, struct namespacekey_s, node);
-    int h = a->hash - b->hash;
-    if (h != 0) return h; 
-    return str_cmp(&a->key->cfname, &b->key->cfname);
+static inline bool label_match(const struct namespacekey_s *a, const struct namespacekey_s *b) {
+    return a->hash == b->hash && str_cmp(&a->key->cfname, &b->key->cfname) == 0;
 }
 
-static int label_compare2(const struct avltree_node *aa, const struct avltree_node *bb)
-{
-    const struct namespacekey_s *a = cavltree_container_of(aa, struct namespacekey_s, node);
-    const struct namespacekey_s *b = cavltree_container_of(bb, struct namespacekey_s, node);
-    int h = a->hash - b->hash;
-    if (h != 0) return h; 
-    h = str_cmp(&a->key->cfname, &b->key->cfname);
-    if (h != 0) return h;
-    return b->key->strength - a->key->strength;
+static inline bool label_valid(const Label *l) {
+    return l->defpass == pass || (l->constant && (!fixeddig || l->defpass == pass - 1));
 }
 
-static struct namespacekey_s *strongest_label(struct avltree_node *b) {
-    struct namespacekey_s *a = NULL, *c; 
-    struct avltree_node *n = b;
+/* The label of the exact strength */
+static struct namespacekey_s *label_lookup(const Namespace *ns, const struct namespacekey_s *tmp) {
+    size_t i;
+    if (ns->data == NULL) return NULL;
+    for (i = namespace_slot(ns, tmp->hash); ns->data[i].key != NULL; i = (i + 1) & ns->mask) {
+        struct namespacekey_s *c = &ns->data[i];
+        if (label_match(c, tmp) && c->key->strength == tmp->key->strength) return c;
+    }
+    return NULL;
+}
 
-    do {
-        c = avltree_container_of(n, struct namespacekey_s, node);
-        if (c->key->defpass == pass || (c->key->constant && (!fixeddig || c->key->defpass == pass - 1))) a = c;
-        n = avltree_next(n);
-    } while (n != NULL && label_compare(n, b) == 0);
-    if (a != NULL) return a;
-    n = avltree_prev(b);
-    while (n != NULL && label_compare(n, b) == 0) {
-        c = avltree_container_of(n, struct namespacekey_s, node);
-        if (c->key->defpass == pass || (c->key->constant && (!fixeddig || c->key->defpass == pass - 1))) a = c;
-        n = avltree_prev(n);
+/* The strongest usable one of the labels with this name */
+static struct namespacekey_s *strongest_label(const Namespace *ns, const struct namespacekey_s *tmp) {
+    struct namespacekey_s *a = NULL;
+    size_t i;
+    if (ns->data == NULL) return NULL;
+    for (i = namespace_slot(ns, tmp->hash); ns->data[i].key != NULL; i = (i + 1) & ns->mask) {
+        struct namespacekey_s *c = &ns->data[i];
+        if (!label_match(c, tmp) || !label_valid(c->key)) continue;
+        if (a == NULL || c->key->strength < a->key->strength) a = c;
     }
     return a;
 }
 
-Label *find_label(const str_t *name, Namespace **here) {
-    struct avltree_node *b;
-    struct namespacekey_s tmp, *c;
-    size_t p = context_stack.p;
-    Label label;
+/* Any of the labels with this name, for builtins */
+static struct namespacekey_s *any_label(const Namespace *ns, const struct namespacekey_s *tmp) {
+    size_t i;
+    if (ns->data == NULL) return NULL;
+    for (i = namespace_slot(ns, tmp->hash); ns->data[i].key != NULL; i = (i + 1) & ns->mask) {
+        if (label_match(&ns->data[i], tmp)) return &ns->data[i];
+    }
+    return NULL;
+}
 
-    tmp.key = &label;
-    if (name->len > 1 && name->data[1] == 0) tmp.key->cfname = *name;
-    else str_cfcpy(&tmp.key->cfname, name);
-    tmp.hash = str_hash(&tmp.key->cfname);
+/* Pass of the last lookup per name hash which didn't find a label defined in
+   this pass, or found one which a stronger definition could still replace.
+   Creating such a label later in the pass requires another pass, otherwise
+   the earlier lookups would not see it. */
+static uint8_t label_misses[4096];
+
+static inline void label_miss(int hash) {
+    label_misses[hash & (lenof(label_misses) - 1)] = pass;
+}
+
+bool label_missed(const str_t *name) {
+    str_t cfname;
+    if (name->len > 1 && name->data[1] == 0) cfname = *name;
+    else str_cfcpy(&cfname, name);
+    return label_misses[str_hash(&cfname) & (lenof(label_misses) - 1)] == pass;
+}
+
+/* A not yet defined seed from the label cache hides the label which would be
+   found without it, that one still needs to be checked for shadowing */
+static void seed_shadow(const struct namespacekey_s *tmp, size_t p) {
+    struct namespacekey_s *c;
+
+    while (context_stack.bottom < p) {
+        c = strongest_label(context_stack.stack[--p].normal, tmp);
+        if (c != NULL && c->key->defpass != 0) {
+            c->key->shadowcheck = true;
+            return;
+        }
+    }
+}
+
+static Label *find_key(const struct namespacekey_s *tmp, Namespace **here) {
+    struct namespacekey_s *c;
+    size_t p = context_stack.p;
 
     while (context_stack.bottom < p) {
         Namespace *context = context_stack.stack[--p].normal;
-        b = avltree_lookup(&tmp.node, &context->members, label_compare);
-        if (b != NULL) {
-            c = strongest_label(b);
-            if (c != NULL) {
-                if (here != NULL) *here = context;
-                return c->key;
-            }
+        c = strongest_label(context, tmp);
+        if (c != NULL) {
+            if (here != NULL) *here = context;
+            if (c->key->defpass == 0) seed_shadow(tmp, p);
+            if (c->key->defpass != pass || c->key->strength != 0 || p + 1 != context_stack.p) label_miss(tmp->hash);
+            return c->key;
         }
     }
-    b = avltree_lookup(&tmp.node, &builtin_namespace->members, label_compare);
-    if (b != NULL) {
+    label_miss(tmp->hash);
+    c = any_label(builtin_namespace, tmp);
+    if (c != NULL) {
         if (here != NULL) *here = builtin_namespace;
-        return avltree_container_of(b, struct namespacekey_s, node)->key;
+        return c->key;
     }
     if (here != NULL) *here = NULL;
     return NULL;
 }
 
+static Label *find_key2(const struct namespacekey_s *tmp, Namespace *context) {
+    struct namespacekey_s *c = strongest_label(context, tmp);
+    if (c == NULL || c->key->defpass != pass || c->key->strength != 0) label_miss(tmp->hash);
+    return (c != NULL) ? c->key : NULL;
+}
+
+/* Labels looked up by name outside of expressions might get defined or
+   redefined next, which invalidates the cached lookups */
+static inline Label *label_defining(Label *l) {
+    if (l != NULL && l->defpass != pass) label_generation++;
+    return l;
+}
+
+Label *find_label(const str_t *name, Namespace **here) {
+    struct namespacekey_s tmp;
+    Label label;
+
+    tmp.key = &label;
+    if (name->len > 1 && name->data[1] == 0) tmp.key->cfname = *name;
+    else str_cfcpy(&tmp.key->cfname, name);
+    tmp.hash = str_hash(&tmp.key->cfname);
+    return label_defining(find_key(&tmp, here));
+}
+
 Label *find_label2(const str_t *name, Namespace *context) {
-    struct avltree_node *b;
-    struct namespacekey_s tmp, *c;
+    struct namespacekey_s tmp;
     Label label;
 
     tmp.key = &label;
     if (name->len > 1 && name->data[1] == 0) tmp.key->cfname = *name;
     else str_cfcpy(&tmp.key->cfname, name);
     tmp.hash = str_hash(&tmp.key->cfname);
+    return label_defining(find_key2(&tmp, context));
+}
 
-    b = avltree_lookup(&tmp.node, &context->members, label_compare);
-    if (b == NULL) return NULL;
-    c = strongest_label(b);
-    return (c != NULL) ? c->key : NULL;
+/* Identifiers of expressions are interned when parsed, so the case folded
+   name and its hash is only calculated once per distinct identifier and
+   not on every lookup when the expression is replayed. */
+struct atom_entry_s {
+    unsigned int hash;
+    struct atom_s atom;
+};
+
+static struct atom_entry_s **atoms;
+static size_t atoms_mask, atoms_len;
+
+static inline size_t atom_slot(unsigned int h) {
+    return (h ^ (h >> 11) ^ (h >> 22)) & atoms_mask;
+}
+
+static void atoms_grow(void) {
+    struct atom_entry_s **old = atoms;
+    size_t i, oldmask = atoms_mask;
+    size_t size = (old == NULL) ? 1024 : (oldmask + 1) * 2;
+    if (size < 1024 || size > SIZE_MAX / sizeof *atoms) err_msg_out_of_memory(); /* overflow */
+    atoms = (struct atom_entry_s **)mallocx(size * sizeof *atoms);
+    atoms_mask = size - 1;
+    for (i = 0; i < size; i++) atoms[i] = NULL;
+    if (old == NULL) return;
+    for (i = 0; i <= oldmask; i++) {
+        size_t j;
+        if (old[i] == NULL) continue;
+        for (j = atom_slot(old[i]->hash); atoms[j] != NULL; j = (j + 1) & atoms_mask);
+        atoms[j] = old[i];
+    }
+    free(old);
+}
+
+const struct atom_s *intern_ident(const str_t *name) {
+    struct atom_entry_s *a;
+    str_t cf;
+    size_t i;
+    unsigned int h = (unsigned int)str_hash(name);
+    if (atoms == NULL || atoms_len >= atoms_mask - (atoms_mask >> 2)) atoms_grow();
+    for (i = atom_slot(h); atoms[i] != NULL; i = (i + 1) & atoms_mask) {
+        if (atoms[i]->hash == h && str_cmp(&atoms[i]->atom.name, name) == 0) return &atoms[i]->atom;
+    }
+    if (name->len > 1 && name->data[1] == 0) cf = *name;
+    else str_cfcpy(&cf, name);
+    if (name->len > SIZE_MAX - sizeof *a || cf.len > SIZE_MAX - sizeof *a - name->len) err_msg_out_of_memory(); /* overflow */
+    a = (struct atom_entry_s *)mallocx(sizeof *a + name->len + cf.len);
+    a->hash = h;
+    a->atom.name.len = name->len;
+    a->atom.name.data = (const uint8_t *)(a + 1);
+    memcpy((uint8_t *)(a + 1), name->data, name->len);
+    if (cf.data == name->data) a->atom.cfname = a->atom.name;
+    else {
+        a->atom.cfname.len = cf.len;
+        a->atom.cfname.data = a->atom.name.data + name->len;
+        memcpy((uint8_t *)a->atom.cfname.data, cf.data, cf.len);
+    }
+    a->atom.hash = str_hash(&a->atom.cfname);
+    atoms[i] = a;
+    atoms_len++;
+    return &a->atom;
+}
+
+static inline bool lident_valid(const struct lident_s *cache) {
+    return cache->label != NULL && cache->generation == label_generation && cache->pass == pass && cache->fixeddig == fixeddig;
+}
+
+/* Not yet defined seeds are not cached as finding them has side effects */
+static inline void lident_update(struct lident_s *cache, Label *l, Namespace *context) {
+    cache->label = (l != NULL && l->defpass != 0) ? l : NULL;
+    cache->context = context;
+    cache->generation = label_generation;
+    cache->pass = pass;
+    cache->fixeddig = fixeddig;
+}
+
+Label *find_atom(const struct atom_s *atom, Namespace **here, struct lident_s *cache) {
+    struct namespacekey_s tmp;
+    Namespace *context = NULL;
+    Label label, *l;
+
+    if (cache != NULL && lident_valid(cache)) {
+        if (here != NULL) *here = cache->context;
+        return cache->label;
+    }
+    tmp.key = &label;
+    tmp.key->cfname = atom->cfname;
+    tmp.hash = atom->hash;
+    l = find_key(&tmp, &context);
+    if (cache != NULL) lident_update(cache, l, context);
+    if (here != NULL && l != NULL) *here = context;
+    return l;
+}
+
+Label *find_atom2(const struct atom_s *atom, Namespace *context, struct lident_s *cache) {
+    struct namespacekey_s tmp;
+    Label label, *l;
+
+    if (cache != NULL && lident_valid(cache) && cache->context == context) return cache->label;
+    tmp.key = &label;
+    tmp.key->cfname = atom->cfname;
+    tmp.hash = atom->hash;
+    l = find_key2(&tmp, context);
+    if (cache != NULL) lident_update(cache, l, context);
+    return l;
 }
 
 static struct {
@@ -329,7 +488,6 @@ static struct {
 } anon_idents;
 
 Label *find_label3(const str_t *name, Namespace *context, uint8_t strength) {
-    struct avltree_node *b;
     struct namespacekey_s tmp, *c;
     Label label;
 
@@ -339,14 +497,11 @@ Label *find_label3(const str_t *name, Namespace *context, uint8_t strength) {
     tmp.hash = str_hash(&tmp.key->cfname);
     tmp.key->strength = strength;
 
-    b = avltree_lookup(&tmp.node, &context->members, label_compare2);
-    if (b == NULL) return NULL;
-    c = avltree_container_of(b, struct namespacekey_s, node);
-    return (c != NULL) ? c->key : NULL;
+    c = label_lookup(context, &tmp);
+    return label_defining((c != NULL) ? c->key : NULL);
 }
 
 Label *find_anonlabel(int32_t count) {
-    struct avltree_node *b;
     struct namespacekey_s tmp, *c;
     size_t p = context_stack.p;
     Namespace *context;
@@ -363,20 +518,18 @@ Label *find_anonlabel(int32_t count) {
 
     while (context_stack.bottom < p) {
         context = context_stack.stack[--p].normal;
-        b = avltree_lookup(&tmp.node, &context->members, label_compare);
-        if (b != NULL) {
-            c = strongest_label(b);
-            if (c != NULL) return c->key;
+        c = strongest_label(context, &tmp);
+        if (c != NULL) {
+            if (c->key->defpass != pass || c->key->strength != 0) label_miss(tmp.hash);
+            return c->key;
         }
     }
-    b = avltree_lookup(&tmp.node, &builtin_namespace->members, label_compare);
-    if (b == NULL) return NULL;
-    c = avltree_container_of(b, struct namespacekey_s, node);
+    label_miss(tmp.hash);
+    c = any_label(builtin_namespace, &tmp);
     return (c != NULL) ? c->key : NULL;
 }
 
 Label *find_anonlabel2(int32_t count, Namespace *context) {
-    struct avltree_node *b;
     struct namespacekey_s tmp, *c;
     Label label;
 
@@ -389,54 +542,52 @@ Label *find_anonlabel2(int32_t count, Namespace *context) {
     tmp.key->cfname.len = sizeof anon_idents;
     tmp.hash = str_hash(&tmp.key->cfname);
 
-    b = avltree_lookup(&tmp.node, &context->members, label_compare);
-    if (b == NULL) return NULL;
-    c = strongest_label(b);
+    c = strongest_label(context, &tmp);
+    if (c == NULL || c->key->defpass != pass || c->key->strength != 0) label_miss(tmp.hash);
     return (c != NULL) ? c->key : NULL;
 }
 
 /* --------------------------------------------------------------------------- */
 Label *new_label(const str_t *name, Namespace *context, uint8_t strength, bool *exists) {
-    struct avltree_node *b;
-    Label *tmp;
-    if (lastlb2 == NULL) {
-        lastlb2 = namespacekey_alloc();
-    }
+    struct namespacekey_s tmp, *b;
+    const struct atom_s *atom;
+    Label *lb;
     if (lastlb == NULL) lastlb = (Label *)val_alloc(LABEL_OBJ);
 
     if (name->len > 1 && name->data[1] == 0) lastlb->cfname = *name;
     else str_cfcpy(&lastlb->cfname, name);
-    lastlb2->hash = str_hash(&lastlb->cfname);
-    lastlb2->key = lastlb;
+    tmp.hash = str_hash(&lastlb->cfname);
+    tmp.key = lastlb;
     lastlb->strength = strength;
 
-    b = avltree_insert(&lastlb2->node, &context->members, label_compare2);
+    b = label_lookup(context, &tmp);
     
     if (b == NULL) { /* new label */
-        str_cpy(&lastlb->name, name);
-        if (lastlb->cfname.data == name->data) lastlb->cfname = lastlb->name;
-        else str_cfcpy(&lastlb->cfname, NULL);
+        label_generation++;
+        atom = intern_ident(name);
+        lastlb->name = atom->name;
+        lastlb->cfname = atom->cfname;
         lastlb->ref = false;
         lastlb->shadowcheck = false;
         lastlb->update_after = false;
         lastlb->usepass = 0;
         lastlb->defpass = pass;
 	*exists = false;
-	tmp = lastlb;
+	lb = lastlb;
 	lastlb = NULL;
-        lastlb2 = NULL;
-        context->len++;
-	return tmp;
+        namespace_insert(context, tmp.hash, lb);
+	return lb;
     }
     *exists = true;
-    return avltree_container_of(b, struct namespacekey_s, node)->key;            /* already exists */
+    return label_defining(b->key);            /* already exists */
 }
 
 void shadow_check(Namespace *members) {
-    const struct avltree_node *n;
+    size_t n, len;
+    struct namespacekey_s **list = namespace_sorted(members, &len);
 
-    for (n = avltree_first(&members->members); n != NULL; n = avltree_next(n)) {
-        const struct namespacekey_s *l = cavltree_container_of(n, struct namespacekey_s, node);
+    for (n = 0; n < len; n++) {
+        const struct namespacekey_s *l = list[n];
         Label *key2 = l->key;
         Obj *o  = key2->value;
         Namespace *ns;
@@ -465,13 +616,12 @@ void shadow_check(Namespace *members) {
             ns->len = ln;
         }
         if (key2->shadowcheck) {
-            const struct avltree_node *b;
+            const struct namespacekey_s *l2;
             size_t p = context_stack.p;
             Obj *o2 = key2->value;
             while (context_stack.bottom < p) {
-                b = avltree_lookup(&l->node, &context_stack.stack[--p].normal->members, label_compare2);
-                if (b != NULL) {
-                    const struct namespacekey_s *l2 = cavltree_container_of(b, struct namespacekey_s, node);
+                l2 = label_lookup(context_stack.stack[--p].normal, l);
+                if (l2 != NULL) {
                     Label *key1 = l2->key;
                     Obj *o1 = key1->value;
                     if (o1 != o2 && !o1->obj->same(o1, o2)) {
@@ -480,9 +630,8 @@ void shadow_check(Namespace *members) {
                     }
                 }
             }
-            b = avltree_lookup(&l->node, &builtin_namespace->members, label_compare2);
-            if (b != NULL) {
-                const struct namespacekey_s *l2 = cavltree_container_of(b, struct namespacekey_s, node);
+            l2 = label_lookup(builtin_namespace, l);
+            if (l2 != NULL) {
                 Label *key1 = l2->key;
                 Obj *o1 = key1->value;
                 if (o1 != o2 && !o1->obj->same(o1, o2)) {
@@ -491,25 +640,20 @@ void shadow_check(Namespace *members) {
             }
         }
     }
+    free(list);
 }
 
-static Label *find_strongest_label(struct avltree_node **x, avltree_cmp_fn_t cmp) {
-    struct namespacekey_s *a = NULL, *c; 
-    struct avltree_node *b = *x, *n = b;
+/* The sorted list has the labels of the same name next to each other, the
+   strongest one last */
+static Label *find_strongest_label(struct namespacekey_s **list, size_t *x, size_t len) {
+    struct namespacekey_s *a = NULL, *b = list[*x];
+    size_t n = *x;
     do {
-        c = avltree_container_of(n, struct namespacekey_s, node);
-        if (c->key->defpass == pass) a = c;
-        n = avltree_next(n);
-    } while (n != NULL && cmp(n, b) == 0);
+        if (list[n]->key->defpass == pass) a = list[n];
+        n++;
+    } while (n < len && label_match(list[n], b));
     *x = n;
-    if (a != NULL) return a->key;
-    n = avltree_prev(b);
-    while (n != NULL && cmp(n, b) == 0) {
-        c = avltree_container_of(n, struct namespacekey_s, node);
-        if (c->key->defpass == pass) return c->key;
-        n = avltree_prev(n);
-    }
-    return NULL;
+    return (a != NULL) ? a->key : NULL;
 }
 
 static inline void padding(int l, int t, FILE *f) {
@@ -529,13 +673,13 @@ static void labelname_print(Label *l, FILE *flab, char d) {
     printable_print2(l->name.data, flab, l->name.len);
 }
 
-static void labelprint2(const struct avltree *members, FILE *flab, int labelmode) {
-    struct avltree_node *n;
+static void labelprint2(const Namespace *members, FILE *flab, int labelmode) {
+    size_t n = 0, n_members;
+    struct namespacekey_s **list = namespace_sorted(members, &n_members);
     Label *l;
 
-    n = avltree_first(members);
-    while (n != NULL) {
-        l = find_strongest_label(&n, label_compare);            /* already exists */
+    while (n < n_members) {
+        l = find_strongest_label(list, &n, n_members);            /* already exists */
         if (l == NULL || l->name.data == NULL) continue;
         if (l->name.len > 1 && l->name.data[1] == 0) continue;
         switch (l->value->obj->type) {
@@ -578,7 +722,7 @@ static void labelprint2(const struct avltree *members, FILE *flab, int labelmode
                     size_t ln = code->names->len;
                     code->names->len = 0;
                     push_label(l);
-                    labelprint2(&code->names->members, flab, labelmode);
+                    labelprint2(code->names, flab, labelmode);
                     pop_label();
                     code->names->len = ln;
                 }
@@ -598,6 +742,7 @@ static void labelprint2(const struct avltree *members, FILE *flab, int labelmode
             val_destroy(&val->v);
         }
     }
+    free(list);
 }
 
 static inline const uint8_t *get_line(const struct file_s *file, size_t line) {
@@ -605,15 +750,15 @@ static inline const uint8_t *get_line(const struct file_s *file, size_t line) {
 }
 
 static void labeldump(Namespace *members, FILE *flab) {
-    const struct avltree_node *n;
+    size_t n, len;
+    struct namespacekey_s **list = namespace_sorted(members, &len);
 
-    for (n = avltree_first(&members->members); n != NULL; n = avltree_next(n)) {
-        const struct namespacekey_s *l = cavltree_container_of(n, struct namespacekey_s, node);
-        Label *l2 = l->key;
+    for (n = 0; n < len; n++) {
+        Label *l2 = list[n]->key;
         Obj *o  = l2->value;
         Namespace *ns;
 
-        if (l2->name.len < 2 || l2->name.data[1] != 0) {
+        if ((l2->name.len < 2 || l2->name.data[1] != 0) && l2->file_list != NULL) {
             Str *val = (Str *)l2->value->obj->repr(l2->value, NULL, SIZE_MAX);
             if (val != NULL) {
                 if (val->v.obj == STR_OBJ) {
@@ -657,6 +802,7 @@ static void labeldump(Namespace *members, FILE *flab) {
             }
         }
     }
+    free(list);
 }
 
 void labelprint(void) {
@@ -677,7 +823,7 @@ void labelprint(void) {
     if (arguments.label_mode == LABEL_DUMP) {
         labeldump(root_namespace, flab);
     } else {
-        labelprint2(&root_namespace->members, flab, arguments.label_mode);
+        labelprint2(root_namespace, flab, arguments.label_mode);
     }
     free(label_stack.stack);
     referenceit = oldreferenceit;
@@ -686,6 +832,364 @@ void labelprint(void) {
     if (err != 0 && errno != 0) err_msg_file(ERROR_CANT_WRTE_LBL, arguments.label, &nopoint);
 }
 
+/* Label cache. The final values of constants and code labels are saved
+   after a successful build and used to seed the first pass of the next one.
+   It's only loaded if the options which change the result and the content
+   of all files used are unchanged, and the passes still have to converge. */
+#define LABELCACHE_HEADER "64tass label cache V" VERSION "\n"
+
+/* Code seeds have a size already, like code from an earlier pass */
+#define SEED_PASS 255
+
+static Label **seeds;
+static size_t seeds_p, seeds_len;
+
+/* Output file names, listing and diagnostic options are left out */
+static uint32_t options_hash(const struct file_s *cmdline, int argc, char *argv[]) {
+    const struct cpu_s *cpu = arguments.cpumode;
+    uint32_t h = FILE_HASH_INIT;
+    uint8_t opts[6];
+    line_t i;
+    int j;
+
+    opts[0] = arguments.toascii;
+    opts[1] = arguments.longbranch;
+    opts[2] = arguments.longaddr;
+    opts[3] = arguments.tasmcomp;
+    opts[4] = arguments.caseinsensitive;
+    opts[5] = (uint8_t)arguments.output_mode;
+    h = file_hash(h, opts, sizeof opts);
+    h = file_hash(h, (const uint8_t *)cpu->mnemonic, cpu->opcodes * sizeof *cpu->mnemonic);
+    for (i = 0; i < cmdline->lines; i++) { /* -D definitions */
+        const char *d = (const char *)cmdline->data + cmdline->line[i];
+        h = file_hash(h, (const uint8_t *)d, strlen(d) + 1);
+    }
+    h = include_list_hash(h);
+    for (j = 0; j < argc; j++) {
+        h = file_hash(h, (const uint8_t *)argv[j], strlen(argv[j]) + 1);
+    }
+    return h;
+}
+
+/* Values are a type letter followed by the fields: "i <integer>",
+   "b <bits> <value>", "a <addressing mode> <value>" and for code
+   "c <size> <dtype> <requires> <conflicts> <address>". Nothing is
+   written when f is NULL, that's to check if the value can be saved. */
+static bool seed_print(FILE *f, Obj *val) {
+    struct linepos_s nopoint = {0, 0};
+    Error *err;
+    uval_t uv;
+
+    switch (val->obj->type) {
+    case T_INT:
+        err = val->obj->ival(val, (ival_t *)&uv, 8 * sizeof uv, &nopoint);
+        if (err != NULL) break;
+        if (f != NULL) fprintf(f, "i %" PRIdval " ", (ival_t)uv);
+        return true;
+    case T_BITS:
+        {
+            const Bits *v1 = (const Bits *)val;
+            if (v1->len < 0 || v1->bits == 0 || v1->bits > 8 * sizeof uv) return false;
+            err = val->obj->uval(val, &uv, 8 * sizeof uv, &nopoint);
+            if (err != NULL) break;
+            if (f != NULL) fprintf(f, "b %" PRIuSIZE " %" PRIuval " ", v1->bits, uv);
+            return true;
+        }
+    case T_ADDRESS:
+        {
+            const Address *v1 = (const Address *)val;
+            if (f != NULL) fprintf(f, "a %" PRIu32 " ", v1->type);
+            return seed_print(f, v1->val);
+        }
+    case T_CODE:
+        {
+            const Code *v1 = (const Code *)val;
+            if (f != NULL) fprintf(f, "c %" PRIuSIZE " %d %" PRIuval " %" PRIuval " ", v1->size, v1->dtype, v1->requires, v1->conflicts);
+            return seed_print(f, v1->addr);
+        }
+    default:
+        return false;
+    }
+    val_destroy(&err->v);
+    return false;
+}
+
+static void labelcache_print(Namespace *members, FILE *f, unsigned int depth) {
+    size_t n, len;
+    struct namespacekey_s **list = namespace_sorted(members, &len);
+
+    for (n = 0; n < len; n++) {
+        Label *l2 = list[n]->key;
+        Code *code = NULL;
+        size_t i;
+
+        if (l2->defpass != pass || !l2->constant || l2->strength != 0) continue;
+        if (l2->owner) {
+            if (l2->value->obj != CODE_OBJ) continue;
+            code = (Code *)l2->value;
+        }
+        if (!seed_print(NULL, l2->value)) continue;
+        if (code != NULL) fprintf(f, "%u c %d ", depth, l2->ref ? 1 : 0);
+        else fprintf(f, "%u = ", depth);
+        seed_print(f, l2->value);
+        for (i = 0; i < l2->name.len; i++) {
+            putc("0123456789abcdef"[l2->name.data[i] >> 4], f);
+            putc("0123456789abcdef"[l2->name.data[i] & 15], f);
+        }
+        putc('\n', f);
+
+        if (code != NULL && code->names->len != 0) {
+            size_t ln = code->names->len;
+            code->names->len = 0;
+            labelcache_print(code->names, f, depth + 1);
+            code->names->len = ln;
+        }
+    }
+    free(list);
+}
+
+void labelcache_save(const struct file_s *cmdline, int argc, char *argv[]) {
+    FILE *f;
+    struct linepos_s nopoint = {0, 0};
+    int err;
+
+    f = file_open(arguments.labelcache, "wb");
+    if (f == NULL) {
+        err_msg_file(ERROR_CANT_WRTE_LBL, arguments.labelcache, &nopoint);
+        return;
+    }
+    clearerr(f);
+    fputs(LABELCACHE_HEADER, f);
+    fprintf(f, "options %08" PRIx32 "\n", options_hash(cmdline, argc, argv));
+    if (file_hashes_print(f)) {
+        fputs("labels\n", f);
+        labelcache_print(root_namespace, f, 0);
+    }
+    err = ferror(f);
+    err |= fclose(f);
+    if (err != 0 && errno != 0) err_msg_file(ERROR_CANT_WRTE_LBL, arguments.labelcache, &nopoint);
+}
+
+static int hexdigit(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    return -1;
+}
+
+/* Names are stored in hexadecimal as anonymous labels are binary */
+static bool hex_name(char *s, str_t *name) {
+    uint8_t *d = (uint8_t *)s;
+    size_t i;
+    name->data = d;
+    for (i = 0; *s != 0; i++, s += 2) {
+        int h = hexdigit(s[0]), l = hexdigit(s[1]);
+        if (h < 0 || l < 0) return false;
+        d[i] = (h << 4) | l;
+    }
+    name->len = i;
+    return i != 0;
+}
+
+/* Reads a value written by seed_print and the space after it */
+static Obj *seed_parse(char **line) {
+    struct linepos_s nopoint = {0, 0};
+    char *s = *line;
+    char kind = s[0];
+    Obj *val;
+
+    if (kind == 0 || s[1] != ' ') return NULL;
+    s += 2;
+    switch (kind) {
+    case 'i':
+        {
+            long iv = strtol(s, &s, 10);
+            if ((ival_t)iv != iv) return NULL;
+            val = (Obj *)int_from_ival(iv);
+            break;
+        }
+    case 'b':
+        {
+            unsigned long bits, uv;
+            bits = strtoul(s, &s, 10);
+            if (*s != ' ' || bits == 0 || bits > 8 * sizeof(uval_t)) return NULL;
+            uv = strtoul(s, &s, 10);
+            if ((uval_t)uv != uv) return NULL;
+            val = (Obj *)bits_from_uval(uv, bits);
+            break;
+        }
+    case 'a':
+        {
+            unsigned long type = strtoul(s, &s, 10);
+            if (*s != ' ' || (atype_t)type != type) return NULL;
+            s++;
+            val = seed_parse(&s);
+            if (val == NULL) return NULL;
+            *line = s;
+            return (Obj *)new_address(val, type);
+        }
+    case 'c':
+        {
+            unsigned long size, requires, conflicts;
+            long dtype;
+            Code *code;
+            size = strtoul(s, &s, 10);
+            if (*s != ' ') return NULL;
+            dtype = strtol(s, &s, 10);
+            if (*s != ' ' || (signed char)dtype != dtype) return NULL;
+            requires = strtoul(s, &s, 10);
+            if (*s != ' ' || (uval_t)requires != requires) return NULL;
+            conflicts = strtoul(s, &s, 10);
+            if (*s != ' ' || (uval_t)conflicts != conflicts) return NULL;
+            s++;
+            val = seed_parse(&s);
+            if (val == NULL) return NULL;
+            code = new_code();
+            code->addr = val;
+            code->size = size;
+            code->dtype = dtype;
+            code->pass = SEED_PASS;
+            code->apass = 0;
+            code->mem = NULL;
+            code->memp = 0;
+            code->membp = 0;
+            code->names = new_namespace(NULL, &nopoint);
+            code->requires = requires;
+            code->conflicts = conflicts;
+            *line = s;
+            return &code->v;
+        }
+    default:
+        return NULL;
+    }
+    if (*s != ' ') {
+        val_destroy(val);
+        return NULL;
+    }
+    *line = s + 1;
+    return val;
+}
+
+static Label *new_seed(char *line, Namespace *context) {
+    struct linepos_s nopoint = {0, 0};
+    Label *label;
+    Obj *val;
+    str_t name;
+    bool exists, ref = false;
+    char kind = line[0];
+    char *s = line + 2;
+
+    if ((kind != 'c' && kind != '=') || line[1] != ' ') return NULL;
+    if (kind == 'c') {
+        if ((s[0] != '0' && s[0] != '1') || s[1] != ' ') return NULL;
+        ref = (s[0] == '1');
+        s += 2;
+    }
+    val = seed_parse(&s);
+    if (val == NULL) return NULL;
+    if ((kind == 'c' && val->obj != CODE_OBJ) || !hex_name(s, &name)) {
+        val_destroy(val);
+        return NULL;
+    }
+
+    label = new_label(&name, context, 0, &exists);
+    if (exists) {
+        val_destroy(val);
+        return NULL;
+    }
+    label->constant = true;
+    label->owner = (kind == 'c');
+    label->ref = ref;
+    label->file_list = NULL;
+    label->epoint = nopoint;
+    label->value = val;
+    if (seeds_p >= seeds_len) {
+        seeds_len += 256;
+        if (/*seeds_len < 256 ||*/ seeds_len > SIZE_MAX / sizeof *seeds) err_msg_out_of_memory(); /* overflow */
+        seeds = (Label **)reallocx(seeds, seeds_len * sizeof *seeds);
+    }
+    seeds[seeds_p++] = label;
+    return label;
+}
+
+void labelcache_load(const struct file_s *cmdline, int argc, char *argv[]) {
+    FILE *f;
+    char *data, *s, *e;
+    size_t len = 0, top = 0, max = 0;
+    Namespace **contexts = NULL;
+    bool labels = false;
+
+    f = file_open(arguments.labelcache, "rb");
+    if (f == NULL) return;
+    data = NULL;
+    for (;;) {
+        data = (char *)reallocx(data, len + BUFSIZ + 1);
+        s = data + len;
+        len += fread(s, 1, BUFSIZ, f);
+        if (len != (size_t)(s - data) + BUFSIZ) break;
+    }
+    if (ferror(f) != 0) len = 0;
+    fclose(f);
+    data[len] = 0;
+
+    s = data;
+    if (strncmp(s, LABELCACHE_HEADER, strlen(LABELCACHE_HEADER)) != 0) goto failed;
+    s += strlen(LABELCACHE_HEADER);
+    while (*s != 0) {
+        e = strchr(s, '\n');
+        if (e == NULL) break;
+        *e = 0;
+        if (labels) {
+            unsigned long depth = strtoul(s, &s, 10);
+            Label *label;
+            if (*s != ' ' || depth > top) goto next;
+            label = new_seed(s + 1, contexts[depth]);
+            if (label == NULL) {
+                top = depth;
+                goto next;
+            }
+            if (label->owner) {
+                top = depth + 1;
+                if (top >= max) {
+                    max += 16;
+                    contexts = (Namespace **)reallocx(contexts, max * sizeof *contexts);
+                }
+                contexts[top] = ((Code *)label->value)->names;
+            } else top = depth;
+        } else if (strncmp(s, "options ", 8) == 0) {
+            if (strtoul(s + 8, NULL, 16) != options_hash(cmdline, argc, argv)) goto failed;
+        } else if (strncmp(s, "file ", 5) == 0) {
+            unsigned long hash = strtoul(s + 5, &s, 16);
+            if (*s != ' ' || !file_hash_check(s + 1, hash)) goto failed;
+        } else if (strcmp(s, "labels") == 0) {
+            labels = true;
+            max = 16;
+            contexts = (Namespace **)mallocx(max * sizeof *contexts);
+            contexts[0] = root_namespace;
+        } else goto failed;
+    next:
+        s = e + 1;
+    }
+failed:
+    free(contexts);
+    free(data);
+}
+
+/* Seeds which were not defined in the first pass must not be found later */
+void labelcache_unseed(void) {
+    size_t i;
+    for (i = 0; i < seeds_p; i++) {
+        Label *label = seeds[i];
+        if (label->defpass != 0) continue;
+        label->constant = false;
+        label->shadowcheck = false;
+        label->ref = false;
+        if (label->owner) ((Code *)label->value)->pass = 0;
+    }
+    free(seeds);
+    seeds = NULL;
+    seeds_p = seeds_len = 0;
+}
+
 void new_builtin(const char *ident, Obj *val) {
     struct linepos_s nopoint = {0, 0};
     str_t name;
@@ -744,11 +1248,17 @@ void destroy_variables(void)
     val_destroy(&root_namespace->v);
     val_destroy(&cheap_context->v);
     destroy_lastlb();
-    if (lastlb2 != NULL) namespacekey_free(lastlb2);
     while (context_stack.p != 0) {
         struct cstack_s *c = &context_stack.stack[--context_stack.p];
         val_destroy(&c->normal->v);
         val_destroy(&c->cheap->v);
     }
     free(context_stack.stack);
+    if (atoms != NULL) {
+        size_t i;
+        for (i = 0; i <= atoms_mask; i++) free(atoms[i]);
+        free(atoms);
+        atoms = NULL;
+        atoms_len = 0;
+    }
 }
@@ -25,6 +25,14 @@
 extern struct Type *LABEL_OBJ;
 
 struct Namespace;
+struct lident_s;
+struct file_s;
+
+struct atom_s {
+    str_t name;
+    str_t cfname;
+    int hash;
+};
 
 typedef struct Label {
     Obj v;
@@ -54,13 +62,21 @@ extern size_t context_get_bottom(void);
 extern void context_set_bottom(size_t);
 
 extern struct Namespace *current_context, *cheap_context, *root_namespace;
+extern unsigned int label_generation;
+extern bool label_missed(const str_t *);
 extern Label *find_label(const str_t *, struct Namespace **);
 extern Label *find_label2(const str_t *, struct Namespace *);
+extern const struct atom_s *intern_ident(const str_t *);
+extern Label *find_atom(const struct atom_s *, struct Namespace **, struct lident_s *);
+extern Label *find_atom2(const struct atom_s *, struct Namespace *, struct lident_s *);
 extern Label *find_label3(const str_t *, struct Namespace *, uint8_t);
 extern Label *find_anonlabel(int32_t);
 extern Label *find_anonlabel2(int32_t, struct Namespace *);
 extern Label *new_label(const str_t *, struct Namespace *, uint8_t, bool *);
 extern void labelprint(void);
+extern void labelcache_save(const struct file_s *, int, char *[]);
+extern void labelcache_load(const struct file_s *, int, char *[]);
+extern void labelcache_unseed(void);
 extern void shadow_check(struct Namespace *);
 extern void destroy_variables(void);
 extern void init_variables(void);